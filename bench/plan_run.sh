@@ -0,0 +1,73 @@
+#!/bin/sh
+#
+# bench/plan_run.sh
+#
+# measure plan quality with and without pgds: a TPC-H like dataset is
+# generated without statistics (bench/plan_schema.sql), then the query set
+# is run once, cold, in a copy of this database for each pgds mode. End-to-end
+# latency and estimate versus actual rows errors are reported per query.
+#
+# pgds must be installed (make install).
+#
+# settings (environment):
+# BENCH_SF		scale factor (default 0.1)
+# BENCH_MODES		pgds modes (default "off sync async")
+# BENCH_DATA		temporary instance directory (default /tmp/pgds_bench_plan)
+# BENCH_PORT		temporary instance port (default 5557)
+#
+set -e
+
+PG_CONFIG=${PG_CONFIG:-pg_config}
+BINDIR=$($PG_CONFIG --bindir)
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+SF=${BENCH_SF:-0.1}
+MODES=${BENCH_MODES:-"off sync async"}
+DATA=${BENCH_DATA:-/tmp/pgds_bench_plan}
+PORT=${BENCH_PORT:-5557}
+TEMPLATE=pgds_bench_plan
+RESULTS=$DATA.results
+
+trap '"$BINDIR/pg_ctl" -D "$DATA" -m immediate stop >/dev/null 2>&1 || true' EXIT
+
+rm -rf "$DATA" "$RESULTS"
+"$BINDIR/initdb" -D "$DATA" -A trust >/dev/null
+"$BINDIR/pg_ctl" -D "$DATA" -l "$DATA.log" -w \
+	-o "-p $PORT -c shared_preload_libraries=pgds -c autovacuum=off" start >/dev/null
+
+echo "bench: generating dataset (scale factor $SF)" >&2
+"$BINDIR/createdb" -p $PORT $TEMPLATE
+PGOPTIONS="-c pgds.mode=off" "$BINDIR/psql" -q -X -p $PORT -d $TEMPLATE \
+	-c "create extension pgds" >/dev/null
+PGOPTIONS="-c pgds.mode=off" "$BINDIR/psql" -q -X -p $PORT -d $TEMPLATE \
+	-f "$BENCH_DIR/plan_schema.sql" -v sf=$SF >/dev/null
+
+for mode in $MODES; do
+	echo "bench: pgds.mode=$mode" >&2
+	"$BINDIR/createdb" -p $PORT -T $TEMPLATE ${TEMPLATE}_$mode
+	PGOPTIONS="-c pgds.mode=$mode -c client_min_messages=warning" \
+	"$BINDIR/psql" -q -X -A -t -F ' ' -p $PORT -d ${TEMPLATE}_$mode <<SQL >>"$RESULTS"
+select format('select %L, %L, round(total_ms::numeric, 1), round(max_qerror::numeric, 1),
+	top_estimated, top_actual from bench_explain(%L)', '$mode', name, query)
+from bench_query order by name
+\gexec
+SQL
+done
+
+awk '
+	{
+		if (!($2 in seen)) { seen[$2] = 1; order[++n] = $2 }
+		if (!($1 in mseen)) { mseen[$1] = 1; modes[++m] = $1 }
+		ms[$1, $2] = $3; qerr[$1, $2] = $4
+	}
+	END {
+		printf "%-22s", "query"
+		for (j = 1; j <= m; j++)
+			printf " %14s %10s", modes[j] " ms", modes[j] " q-err"
+		printf "\n"
+		for (i = 1; i <= n; i++) {
+			printf "%-22s", order[i]
+			for (j = 1; j <= m; j++)
+				printf " %14s %10s", ms[modes[j], order[i]], qerr[modes[j], order[i]]
+			printf "\n"
+		}
+	}' "$RESULTS"
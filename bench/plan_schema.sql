@@ -0,0 +1,145 @@
+--
+-- bench/plan_schema.sql
+--
+-- TPC-H like dataset of scale factor :sf with skew, correlated columns
+-- and monthly partitions of orders and lineitem. Data is generated with
+-- a fixed seed and is the same for each run.
+--
+\set ON_ERROR_STOP on
+select set_config('bench.sf', :'sf', false);
+select setseed(0.42);
+--
+create table region(r_regionkey int primary key, r_name text);
+insert into region values (0, 'AFRICA'), (1, 'AMERICA'), (2, 'ASIA'), (3, 'EUROPE'), (4, 'MIDDLE EAST');
+--
+create table nation(n_nationkey int primary key, n_name text, n_regionkey int);
+insert into nation select g, 'NATION' || g, g % 5 from generate_series(0, 24) g;
+--
+create table supplier(s_suppkey int primary key, s_name text, s_nationkey int, s_acctbal numeric);
+insert into supplier
+select g, 'Supplier#' || g, g % 25, round((random() * 10000)::numeric, 2)
+from generate_series(1, (10000 * current_setting('bench.sf')::float8)::int) g;
+--
+-- p_mfgr is determined by p_brand (functional dependency)
+--
+create table part(p_partkey int primary key, p_name text, p_brand int, p_mfgr int, p_size int, p_retailprice numeric);
+insert into part
+select g, 'part' || g, b, b / 5, 1 + (random() * 49)::int, 900 + g % 1000
+from (select g, (random() * 24)::int as b
+      from generate_series(1, (200000 * current_setting('bench.sf')::float8)::int) g) p;
+--
+-- c_mktsegment is correlated with c_nationkey
+--
+create table customer(c_custkey int primary key, c_name text, c_nationkey int, c_mktsegment text, c_acctbal numeric);
+insert into customer
+select g, 'Customer#' || g, n,
+       (array['AUTOMOBILE', 'BUILDING', 'FURNITURE', 'MACHINERY', 'HOUSEHOLD'])[1 + n % 5],
+       round((random() * 10000)::numeric, 2)
+from (select g, (random() * 24)::int as n
+      from generate_series(1, (150000 * current_setting('bench.sf')::float8)::int) g) c;
+--
+-- orders and lineitem: time series partitioned by month over 1995-1998;
+-- customers and parts are skewed (few customers and parts get most orders)
+--
+create table orders(o_orderkey int, o_custkey int, o_orderstatus char, o_totalprice numeric,
+                    o_orderdate date, o_orderpriority text)
+partition by range(o_orderdate);
+create table lineitem(l_orderkey int, l_partkey int, l_suppkey int, l_linenumber int,
+                      l_quantity int, l_extendedprice numeric, l_discount numeric,
+                      l_returnflag char, l_shipdate date, l_commitdate date, l_receiptdate date)
+partition by range(l_shipdate);
+do $$
+begin
+  for m in 0..47 loop
+    execute format('create table orders_%s partition of orders for values from (%L) to (%L)',
+                   m, date '1995-01-01' + make_interval(months => m),
+                   date '1995-01-01' + make_interval(months => m + 1));
+    execute format('create table lineitem_%s partition of lineitem for values from (%L) to (%L)',
+                   m, date '1995-01-01' + make_interval(months => m),
+                   date '1995-01-01' + make_interval(months => m + 1));
+  end loop;
+  create table lineitem_late partition of lineitem for values from ('1999-01-01') to (maxvalue);
+end;
+$$;
+--
+insert into orders
+select g,
+       1 + (power(random(), 4) * ((150000 * current_setting('bench.sf')::float8)::int - 1))::int,
+       case when d < date '1998-06-01' then 'F' else 'O' end,
+       round((random() * 500000)::numeric, 2),
+       d,
+       (array['1-URGENT', '2-HIGH', '3-MEDIUM', '4-NOT SPECIFIED', '5-LOW'])[1 + (random() * 4)::int]
+from (select g, date '1995-01-01' + (random() * 1400)::int as d
+      from generate_series(1, (1500000 * current_setting('bench.sf')::float8)::int) g) o;
+--
+-- l_shipdate, l_commitdate and l_receiptdate are correlated with o_orderdate
+--
+insert into lineitem
+select o_orderkey,
+       1 + (power(random(), 3) * ((200000 * current_setting('bench.sf')::float8)::int - 1))::int,
+       1 + (random() * ((10000 * current_setting('bench.sf')::float8)::int - 1))::int,
+       l,
+       1 + (random() * 49)::int,
+       round((random() * 100000)::numeric, 2),
+       round((random() * 0.1)::numeric, 2),
+       case when o_orderstatus = 'F' then (array['A', 'R'])[1 + (random())::int] else 'N' end,
+       s, s + 30, s + 1 + (random() * 29)::int
+from (select o_orderkey, o_orderstatus, l, o_orderdate + 1 + (random() * 120)::int as s
+      from orders, generate_series(1, 1 + (o_orderkey % 7)) l) li;
+--
+-- queries: name and text
+--
+create table bench_query(name text primary key, query text);
+insert into bench_query values
+('q01_pricing', $q$select l_returnflag, sum(l_quantity), sum(l_extendedprice * (1 - l_discount)), count(*)
+ from lineitem where l_shipdate <= date '1998-12-01' - 90 group by l_returnflag order by l_returnflag$q$),
+('q03_shipping', $q$select o_orderkey, sum(l_extendedprice * (1 - l_discount)) as revenue, o_orderdate
+ from customer, orders, lineitem
+ where c_mktsegment = 'BUILDING' and c_custkey = o_custkey and l_orderkey = o_orderkey
+ and o_orderdate < date '1995-03-15' and l_shipdate > date '1995-03-15'
+ group by o_orderkey, o_orderdate order by revenue desc limit 10$q$),
+('q05_local_supplier', $q$select n_name, sum(l_extendedprice * (1 - l_discount)) as revenue
+ from customer, orders, lineitem, supplier, nation, region
+ where c_custkey = o_custkey and l_orderkey = o_orderkey and l_suppkey = s_suppkey
+ and c_nationkey = s_nationkey and s_nationkey = n_nationkey and n_regionkey = r_regionkey
+ and r_name = 'ASIA' and o_orderdate >= date '1996-01-01' and o_orderdate < date '1997-01-01'
+ group by n_name order by revenue desc$q$),
+('q06_forecast', $q$select sum(l_extendedprice * l_discount) from lineitem
+ where l_shipdate >= date '1996-01-01' and l_shipdate < date '1997-01-01'
+ and l_discount between 0.05 and 0.07 and l_quantity < 24$q$),
+('q10_skewed_customer', $q$select c_custkey, c_name, sum(o_totalprice) from customer, orders
+ where c_custkey = o_custkey and c_custkey < 50 group by c_custkey, c_name order by 3 desc limit 20$q$),
+('q12_correlated_dates', $q$select count(*) from lineitem
+ where l_receiptdate < l_commitdate and l_shipdate between date '1997-01-01' and date '1997-03-31'$q$),
+('q14_brand_mfgr', $q$select count(*), sum(l_extendedprice) from lineitem, part
+ where l_partkey = p_partkey and p_brand = 12 and p_mfgr = 2$q$),
+('q18_large_orders', $q$select o_orderkey, o_totalprice from orders
+ where o_orderkey in (select l_orderkey from lineitem group by l_orderkey having sum(l_quantity) > 250)
+ order by o_totalprice desc limit 100$q$),
+('q21_segment_nation', $q$select c_mktsegment, count(*) from customer, orders
+ where c_custkey = o_custkey and c_nationkey = 3 and c_mktsegment = 'FURNITURE'
+ and o_orderdate >= date '1998-01-01' group by c_mktsegment$q$);
+--
+-- bench_explain: runs query with EXPLAIN ANALYZE and returns end-to-end latency
+-- (including pgds work done when query is parsed) and estimation errors:
+-- q-error is max(estimated / actual, actual / estimated) over all executed plan nodes
+--
+create function bench_explain(q text, out total_ms float8, out max_qerror float8,
+                              out top_estimated float8, out top_actual float8)
+language plpgsql as $$
+declare
+  t0 timestamptz;
+  p json;
+begin
+  t0 := clock_timestamp();
+  execute 'explain (analyze, format json) ' || q into p;
+  total_ms := extract(epoch from clock_timestamp() - t0) * 1000;
+  top_estimated := (p::jsonb -> 0 -> 'Plan' ->> 'Plan Rows')::float8;
+  top_actual := (p::jsonb -> 0 -> 'Plan' ->> 'Actual Rows')::float8;
+  select max(greatest(e, a) / least(e, a)) into max_qerror
+  from (select greatest((n ->> 'Plan Rows')::float8, 1) as e,
+               greatest((n ->> 'Actual Rows')::float8, 1) as a
+        from jsonb_path_query(p::jsonb, '$.** ? (exists (@."Plan Rows"))') n
+        where (n ->> 'Actual Loops')::float8 > 0) nodes;
+end;
+$$;
@@ -0,0 +1,96 @@
+#!/bin/sh
+#
+# bench/run.sh
+#
+# measure pgds parse hook overhead with pgbench: each scenario runs
+# on a temporary instance without and with pgds in shared_preload_libraries
+# and TPS and average latency deltas are reported.
+#
+# pgds must be installed (make install).
+#
+# settings (environment):
+# BENCH_TABLES		number of tables (default 64)
+# BENCH_DEPTH		depth of nested views (default 3)
+# BENCH_PARTITIONS	number of partitions (default 32)
+# BENCH_CLIENTS		pgbench clients (default 4)
+# BENCH_DURATION	duration of each run in seconds (default 30)
+# BENCH_SCENARIOS	scenarios to run (default "tables views partitions")
+# BENCH_DATA		temporary instance directory (default /tmp/pgds_bench)
+# BENCH_PORT		temporary instance port (default 5556)
+#
+set -e
+
+PG_CONFIG=${PG_CONFIG:-pg_config}
+BINDIR=$($PG_CONFIG --bindir)
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+TABLES=${BENCH_TABLES:-64}
+DEPTH=${BENCH_DEPTH:-3}
+PARTITIONS=${BENCH_PARTITIONS:-32}
+CLIENTS=${BENCH_CLIENTS:-4}
+DURATION=${BENCH_DURATION:-30}
+SCENARIOS=${BENCH_SCENARIOS:-"tables views partitions"}
+DATA=${BENCH_DATA:-/tmp/pgds_bench}
+PORT=${BENCH_PORT:-5556}
+DB=pgds_bench
+RESULTS=$DATA.results
+
+VIEWS=$((TABLES >> DEPTH))
+if [ "$VIEWS" -lt 1 ]; then
+	echo "bench: BENCH_TABLES must be at least 2^BENCH_DEPTH" >&2
+	exit 1
+fi
+
+start()
+{
+	"$BINDIR/pg_ctl" -D "$DATA" -l "$DATA.log" -w \
+		-o "-p $PORT -c shared_preload_libraries='$1'" start >/dev/null
+}
+
+stop()
+{
+	"$BINDIR/pg_ctl" -D "$DATA" -w -m fast stop >/dev/null
+}
+
+trap '"$BINDIR/pg_ctl" -D "$DATA" -m immediate stop >/dev/null 2>&1 || true' EXIT
+
+rm -rf "$DATA" "$RESULTS"
+"$BINDIR/initdb" -D "$DATA" -A trust >/dev/null
+
+start ""
+"$BINDIR/createdb" -p $PORT $DB
+"$BINDIR/psql" -q -X -p $PORT -d $DB -f "$BENCH_DIR/schema.sql" \
+	-v tables=$TABLES -v depth=$DEPTH -v partitions=$PARTITIONS >/dev/null
+stop
+
+for mode in off on; do
+	if [ $mode = on ]; then
+		start pgds
+	else
+		start ""
+	fi
+	for scenario in $SCENARIOS; do
+		echo "bench: $scenario pgds=$mode" >&2
+		"$BINDIR/pgbench" -n -M simple -p $PORT -c $CLIENTS -j $CLIENTS -T $DURATION \
+			-D ntables=$TABLES -D nviews=$VIEWS -D npartitions=$PARTITIONS \
+			-f "$BENCH_DIR/$scenario.pgbench" $DB 2>/dev/null |
+		awk -v s=$scenario -v m=$mode '
+			/^latency average/ { lat = $4 }
+			/^tps/ { tps = $3 }
+			END { print s, m, tps, lat }' >>"$RESULTS"
+	done
+	stop
+done
+
+awk '
+	$2 == "off" { tps_off[$1] = $3; lat_off[$1] = $4; order[++n] = $1 }
+	$2 == "on" { tps_on[$1] = $3; lat_on[$1] = $4 }
+	END {
+		printf "%-12s %12s %12s %8s %12s %12s %8s\n", "scenario", "tps off", "tps on", "delta",
+		       "lat off(ms)", "lat on(ms)", "delta"
+		for (i = 1; i <= n; i++) {
+			s = order[i]
+			printf "%-12s %12.1f %12.1f %7.1f%% %12.3f %12.3f %7.1f%%\n", s,
+			       tps_off[s], tps_on[s], (tps_on[s] - tps_off[s]) * 100 / tps_off[s],
+			       lat_off[s], lat_on[s], (lat_on[s] - lat_off[s]) * 100 / lat_off[s]
+		}
+	}' "$RESULTS"
@@ -0,0 +1,58 @@
+--
+-- bench/schema.sql
+--
+-- pgds benchmark schema:
+-- :tables tables bench_t<i>,
+-- binary trees of nested views of depth :depth over these tables
+-- (top level views are bench_view<k>, like test3.sql),
+-- bench_p table with :partitions range partitions (like test5.sql)
+--
+\set ON_ERROR_STOP on
+select set_config('bench.tables', :'tables', false);
+select set_config('bench.depth', :'depth', false);
+select set_config('bench.partitions', :'partitions', false);
+--
+create extension if not exists pgds;
+--
+do $$
+declare
+  n int := current_setting('bench.tables')::int;
+  d int := current_setting('bench.depth')::int;
+  p int := current_setting('bench.partitions')::int;
+  nv int;
+  name text;
+begin
+  for i in 1..n loop
+    execute format('create table bench_t%s(id int primary key, x int)', i);
+    execute format('insert into bench_t%s select g, g %% 100 from generate_series(1, 1000) g', i);
+  end loop;
+  --
+  nv := n;
+  for l in 1..d loop
+    nv := nv / 2;
+    for k in 1..nv loop
+      if l = d then
+        name := format('bench_view%s', k);
+      else
+        name := format('bench_l%s_v%s', l, k);
+      end if;
+      if l = 1 then
+        execute format('create view %s as select * from bench_t%s union all select * from bench_t%s',
+                       name, 2 * k - 1, 2 * k);
+      else
+        execute format('create view %s as select * from bench_l%s_v%s union all select * from bench_l%s_v%s',
+                       name, l - 1, 2 * k - 1, l - 1, 2 * k);
+      end if;
+    end loop;
+  end loop;
+  --
+  create table bench_p(id int, x int) partition by range(id);
+  for i in 1..p loop
+    execute format('create table bench_p%s partition of bench_p for values from (%s) to (%s)',
+                   i, (i - 1) * 1000 + 1, i * 1000 + 1);
+  end loop;
+  insert into bench_p select g, g % 100 from generate_series(1, p * 1000) g;
+end;
+$$;
+--
+analyze;
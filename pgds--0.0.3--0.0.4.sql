@@ -0,0 +1,273 @@
+--
+-- pgds--0.0.3--0.0.4.sql
+--
+-- copyright Pierre Forstmann 2023
+--
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION pgds UPDATE TO '0.0.4'" to load this file. \quit
+--
+-- pgds_prewarm_from_statements: parse queries from pg_stat_statements
+-- (or from query column of p_queries table) and analyze needed columns
+-- without statistics, with p_workers background workers.
+--
+CREATE FUNCTION pgds_prewarm_from_statements(p_queries regclass DEFAULT NULL, p_workers int DEFAULT 0)
+RETURNS TABLE (relid regclass, columns text)
+AS 'MODULE_PATHNAME', 'pgds_prewarm_from_statements'
+LANGUAGE C VOLATILE;
+--
+-- pgds_export_stats: write statistics of p_rels to server file p_filename.
+-- pgds_import_stats: load statistics from server file p_filename.
+--
+CREATE FUNCTION pgds_export_stats(p_rels regclass[], p_filename text)
+RETURNS bigint
+AS 'MODULE_PATHNAME', 'pgds_export_stats'
+LANGUAGE C VOLATILE;
+--
+CREATE FUNCTION pgds_import_stats(p_filename text)
+RETURNS bigint
+AS 'MODULE_PATHNAME', 'pgds_import_stats'
+LANGUAGE C VOLATILE;
+--
+REVOKE ALL ON FUNCTION pgds_export_stats(regclass[], text) FROM PUBLIC;
+REVOKE ALL ON FUNCTION pgds_import_stats(text) FROM PUBLIC;
+--
+-- pg_stat_pgds: pgds activity counters
+--
+CREATE FUNCTION pgds_stat(
+    OUT calls bigint,
+    OUT rels_examined bigint,
+    OUT view_expansions bigint,
+    OUT catalog_probes bigint,
+    OUT cache_hits bigint,
+    OUT cache_misses bigint,
+    OUT analyze_sync bigint,
+    OUT analyze_async bigint,
+    OUT skip_has_stats bigint,
+    OUT skip_not_owner bigint,
+    OUT skip_recursion bigint,
+    OUT errors bigint,
+    OUT skip_breaker bigint,
+    OUT standby_demands bigint,
+    OUT brin_queued bigint,
+    OUT gin_queued bigint,
+    OUT vacuum_queued bigint,
+    OUT function_estimates bigint,
+    OUT foreign_estimates bigint,
+    OUT batched_probes bigint,
+    OUT quick_stats bigint,
+    OUT governor_deferred bigint,
+    OUT total_time double precision,
+    OUT stats_reset timestamp with time zone)
+RETURNS record
+AS 'MODULE_PATHNAME', 'pgds_stat'
+LANGUAGE C STRICT VOLATILE PARALLEL SAFE;
+--
+CREATE VIEW pg_stat_pgds AS SELECT * FROM pgds_stat();
+--
+CREATE FUNCTION pgds_stat_reset()
+RETURNS void
+AS 'MODULE_PATHNAME', 'pgds_stat_reset'
+LANGUAGE C STRICT VOLATILE PARALLEL SAFE;
+--
+REVOKE ALL ON FUNCTION pgds_stat_reset() FROM PUBLIC;
+--
+-- pg_stat_pgds_relations: pgds per relation counters
+--
+CREATE FUNCTION pgds_relation_stats(
+    OUT dbid oid,
+    OUT relid oid,
+    OUT checks bigint,
+    OUT missing bigint,
+    OUT stale bigint,
+    OUT analyses bigint,
+    OUT total_analyze_time double precision,
+    OUT max_analyze_time double precision,
+    OUT est_rows_sampled bigint,
+    OUT last_queryid bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgds_relation_stats'
+LANGUAGE C STRICT VOLATILE;
+--
+CREATE VIEW pg_stat_pgds_relations AS
+  SELECT s.relid::regclass AS relid,
+         s.checks,
+         s.missing,
+         s.stale,
+         s.analyses,
+         s.total_analyze_time,
+         s.max_analyze_time,
+         s.est_rows_sampled,
+         s.last_queryid
+  FROM pgds_relation_stats() s
+  WHERE s.dbid = (SELECT oid FROM pg_database WHERE datname = current_database());
+--
+CREATE FUNCTION pgds_relation_stats_reset()
+RETURNS void
+AS 'MODULE_PATHNAME', 'pgds_relation_stats_reset'
+LANGUAGE C STRICT VOLATILE;
+--
+REVOKE ALL ON FUNCTION pgds_relation_stats_reset() FROM PUBLIC;
+--
+-- pgds phase latency histograms and percentiles
+--
+CREATE FUNCTION pgds_latency_histogram(
+    OUT phase text,
+    OUT bucket_lower_us bigint,
+    OUT bucket_upper_us bigint,
+    OUT count bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgds_latency_histogram'
+LANGUAGE C STRICT VOLATILE;
+--
+-- percentiles are upper bounds of histogram buckets
+--
+CREATE VIEW pg_stat_pgds_latency AS
+  WITH h AS (
+    SELECT phase,
+           bucket_lower_us,
+           bucket_upper_us,
+           sum(count) OVER (PARTITION BY phase ORDER BY bucket_lower_us) AS cumulated,
+           sum(count) OVER (PARTITION BY phase) AS total
+    FROM pgds_latency_histogram())
+  SELECT phase,
+         max(total)::bigint AS count,
+         min(bucket_upper_us) FILTER (WHERE cumulated >= 0.50 * total) AS p50_us,
+         min(bucket_upper_us) FILTER (WHERE cumulated >= 0.95 * total) AS p95_us,
+         min(bucket_upper_us) FILTER (WHERE cumulated >= 0.99 * total) AS p99_us,
+         max(bucket_lower_us) AS max_lower_us
+  FROM h
+  GROUP BY phase;
+--
+-- pgds event ring
+--
+CREATE FUNCTION pgds_events(
+    OUT event_time timestamptz,
+    OUT pid integer,
+    OUT dbid oid,
+    OUT relid oid,
+    OUT queryid bigint,
+    OUT action text,
+    OUT duration_us bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgds_events'
+LANGUAGE C STRICT VOLATILE;
+--
+REVOKE ALL ON FUNCTION pgds_events() FROM PUBLIC;
+--
+-- relation walker microbenchmark over synthetic query trees
+--
+CREATE FUNCTION pgds_walker_bench(
+    breadth integer,
+    depth integer,
+    in_list integer,
+    iterations integer,
+    OUT queries integer,
+    OUT relations integer,
+    OUT total_us bigint,
+    OUT ns_per_walk double precision)
+RETURNS record
+AS 'MODULE_PATHNAME', 'pgds_walker_bench'
+LANGUAGE C STRICT VOLATILE;
+--
+-- relations without statistics found by queries run on this hot standby
+--
+CREATE FUNCTION pgds_standby_demand(
+    IN consume boolean DEFAULT false,
+    OUT dbid oid,
+    OUT relid oid,
+    OUT relowner oid,
+    OUT demands bigint,
+    OUT last_demand timestamptz)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgds_standby_demand'
+LANGUAGE C STRICT VOLATILE;
+--
+REVOKE ALL ON FUNCTION pgds_standby_demand(boolean) FROM PUBLIC;
+--
+-- removes a demand queued by the primary unless demanded again since
+--
+CREATE FUNCTION pgds_standby_demand_ack(dbid oid, relid oid, last_demand timestamptz)
+RETURNS boolean
+AS 'MODULE_PATHNAME', 'pgds_standby_demand_ack'
+LANGUAGE C STRICT VOLATILE;
+--
+REVOKE ALL ON FUNCTION pgds_standby_demand_ack(oid, oid, timestamptz) FROM PUBLIC;
+--
+-- pg_stat_pgds_functions: observed rows of set returning functions
+--
+CREATE FUNCTION pgds_function_rows(
+    OUT dbid oid,
+    OUT funcid oid,
+    OUT argshash bigint,
+    OUT rows double precision,
+    OUT calls bigint,
+    OUT last_call timestamptz)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgds_function_rows'
+LANGUAGE C STRICT VOLATILE;
+--
+CREATE VIEW pg_stat_pgds_functions AS
+  SELECT s.funcid::regprocedure AS funcid,
+         s.argshash,
+         s.rows,
+         s.calls,
+         s.last_call
+  FROM pgds_function_rows() s
+  WHERE s.dbid = (SELECT oid FROM pg_database WHERE datname = current_database());
+--
+CREATE FUNCTION pgds_function_rows_reset()
+RETURNS void
+AS 'MODULE_PATHNAME', 'pgds_function_rows_reset'
+LANGUAGE C STRICT VOLATILE;
+--
+REVOKE ALL ON FUNCTION pgds_function_rows_reset() FROM PUBLIC;
+--
+-- pg_stat_pgds_foreign_tables: observed rows of foreign table scans
+--
+CREATE FUNCTION pgds_foreign_rows(
+    OUT dbid oid,
+    OUT relid oid,
+    OUT qualhash bigint,
+    OUT rows double precision,
+    OUT scans bigint,
+    OUT last_scan timestamptz)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgds_foreign_rows'
+LANGUAGE C STRICT VOLATILE;
+--
+CREATE VIEW pg_stat_pgds_foreign_tables AS
+  SELECT s.relid::regclass AS relid,
+         s.qualhash,
+         s.rows,
+         s.scans,
+         s.last_scan
+  FROM pgds_foreign_rows() s
+  WHERE s.dbid = (SELECT oid FROM pg_database WHERE datname = current_database());
+--
+CREATE FUNCTION pgds_foreign_rows_reset()
+RETURNS void
+AS 'MODULE_PATHNAME', 'pgds_foreign_rows_reset'
+LANGUAGE C STRICT VOLATILE;
+--
+REVOKE ALL ON FUNCTION pgds_foreign_rows_reset() FROM PUBLIC;
+--
+-- pgds_provisional_stats: relations with quick statistics waiting for ANALYZE
+--
+CREATE FUNCTION pgds_provisional_stats(
+    OUT dbid oid,
+    OUT relid oid,
+    OUT columns integer,
+    OUT created timestamptz)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgds_provisional_stats'
+LANGUAGE C STRICT VOLATILE;
+--
+-- pgds_governor: sampled pages token bucket and running analyses
+--
+CREATE FUNCTION pgds_governor(
+    OUT io_tokens double precision,
+    OUT running integer,
+    OUT io_refill timestamptz)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pgds_governor'
+LANGUAGE C STRICT VOLATILE;
@@ -24,6 +24,7 @@
 #include "parser/parse_node.h"
 #include "parser/analyze.h"
 #include "parser/parser.h"
+#include "parser/scansup.h"
 #include "tcop/tcopprot.h"
 #include "tcop/utility.h"
 #include "utils/guc.h"
@@ -53,28 +54,640 @@
 #include "utils/selfuncs.h"
 #include "optimizer/plancat.h"
 #include "optimizer/planner.h"
+#include "optimizer/paths.h"
+#include "optimizer/cost.h"
+#include "optimizer/optimizer.h"
+#include "executor/instrument.h"
+#if PG_VERSION_NUM >= 130000
+#include "common/hashfn.h"
+#else
+#include "utils/hashutils.h"
+#endif
 #include "nodes/nodeFuncs.h"
+#include "nodes/makefuncs.h"
+#include "catalog/pg_operator.h"
+#include "access/genam.h"
+#include "access/htup_details.h"
+#include "access/sysattr.h"
+#include "access/table.h"
+#include "access/tableam.h"
+#include "access/visibilitymap.h"
+#include "access/transam.h"
+#include "catalog/indexing.h"
+#include "catalog/namespace.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_collation.h"
+#include "catalog/pg_statistic.h"
+#include "catalog/pg_statistic_ext.h"
+#include "catalog/pg_statistic_ext_data.h"
+#include "statistics/statistics.h"
+#include "storage/fd.h"
+#include "storage/lmgr.h"
+#include "utils/array.h"
+#include "utils/fmgroids.h"
+#include "utils/rel.h"
+#include "utils/regproc.h"
+#include "parser/parse_relation.h"
+#include "postmaster/bgworker.h"
+#include "utils/lsyscache.h"
+#include "utils/syscache.h"
+#include "utils/tuplestore.h"
+#include "utils/hsearch.h"
+#include "storage/condition_variable.h"
+#include "storage/latch.h"
+#include "storage/bufmgr.h"
+#include "access/brin_revmap.h"
+#include "access/brin_tuple.h"
+#include "access/gin_private.h"
+#include "access/nbtree.h"
+#include "access/relscan.h"
+#include "utils/typcache.h"
+#include "catalog/pg_am.h"
+#include "catalog/pg_authid.h"
+#include "catalog/pg_language.h"
+#include "catalog/pg_proc.h"
+#include "executor/functions.h"
+#include "rewrite/rowsecurity.h"
+#include "libpq-fe.h"
+#include "port/pg_bswap.h"
+#if PG_VERSION_NUM >= 150000
+#include "common/pg_prng.h"
+#endif
+#if PG_VERSION_NUM >= 140000
+#include "utils/wait_event.h"
+#endif
+#if PG_VERSION_NUM >= 130000
+#include "postmaster/interrupt.h"
+#endif
+#include "pgds_probes.h"
+#include "utils/inval.h"
+#include "utils/timestamp.h"
+#include "portability/instr_time.h"
+#include "port/atomics.h"
+#include "postmaster/autovacuum.h"
+#include "replication/walsender.h"
+#include "commands/vacuum.h"
+#include "commands/explain.h"
+#if PG_VERSION_NUM >= 180000
+#include "utils/pgstat_internal.h"
+#include "commands/defrem.h"
+#include "commands/explain_format.h"
+#include "commands/explain_state.h"
+#endif
 
 PG_MODULE_MAGIC;
 
 /* ---- Static variable definition ---- */
 
+/*
+ * work queue shared with pgds background workers
+ */
+#define	MAX_WORK_ITEMS	1024
+#define	MAX_WORK_ATTS	64
+
+typedef enum pgdsWorkKind
+{
+	PGDS_WORK_FREE = 0,
+	PGDS_WORK_ANALYZE,
+	PGDS_WORK_ANALYZE_MISSING,	/* only if relation still has no statistics */
+	PGDS_WORK_BRIN_SUMMARIZE,	/* relid is BRIN index */
+	PGDS_WORK_GIN_CLEAN,		/* relid is GIN index */
+	PGDS_WORK_VACUUM
+} pgdsWorkKind;
+
+typedef struct pgdsWorkItem
+{
+	pgdsWorkKind	kind;
+	Oid		dboid;
+	Oid		userid;
+	Oid		relid;
+	int		natts;		/* 0 means all columns */
+	int16		attnums[MAX_WORK_ATTS];
+} pgdsWorkItem;
+
+/*
+ * at most one worker drains the work queue of a database and user: slot
+ * is taken by the launching backend and freed by the worker when it finds
+ * the queue empty. A slot whose worker has not started after
+ * PGDS_DRAINER_START_TIMEOUT is reused.
+ */
+#define	PGDS_DRAINERS			64
+#define	PGDS_DRAINER_START_TIMEOUT	60000	/* ms */
+
+typedef struct pgdsDrainer
+{
+	Oid		dboid;
+	Oid		userid;
+	int		pid;		/* 0 until worker has started */
+	TimestampTz	launched;
+} pgdsDrainer;
+
+/*
+ * pg_stat_pgds counters: each backend only increments its own slot,
+ * slots are aggregated when pg_stat_pgds is read
+ */
+typedef enum pgdsStatCounter
+{
+	PGDS_STAT_CALLS = 0,
+	PGDS_STAT_RELS_EXAMINED,
+	PGDS_STAT_VIEW_EXPANSIONS,
+	PGDS_STAT_CATALOG_PROBES,
+	PGDS_STAT_CACHE_HITS,
+	PGDS_STAT_CACHE_MISSES,
+	PGDS_STAT_ANALYZE_SYNC,
+	PGDS_STAT_ANALYZE_ASYNC,
+	PGDS_STAT_SKIP_HAS_STATS,
+	PGDS_STAT_SKIP_NOT_OWNER,
+	PGDS_STAT_SKIP_RECURSION,
+	PGDS_STAT_ERRORS,
+	PGDS_STAT_SKIP_BREAKER,
+	PGDS_STAT_STANDBY_DEMANDS,
+	PGDS_STAT_BRIN_QUEUED,
+	PGDS_STAT_GIN_QUEUED,
+	PGDS_STAT_VACUUM_QUEUED,
+	PGDS_STAT_FUNCTION_ESTIMATES,
+	PGDS_STAT_FOREIGN_ESTIMATES,
+	PGDS_STAT_BATCHED_PROBES,
+	PGDS_STAT_QUICK_STATS,
+	PGDS_STAT_GOVERNOR_DEFERRED,
+	PGDS_STAT_TIME_US,
+	PGDS_STAT_COUNT
+} pgdsStatCounter;
+
+/*
+ * pgds phase latency histograms: bucket 0 counts durations below 1 microsecond,
+ * bucket b durations in [2^(b-1), 2^b[ microseconds, last bucket is unbounded
+ */
+typedef enum pgdsPhase
+{
+	PGDS_PHASE_TREE_WALK = 0,
+	PGDS_PHASE_CATALOG_LOOKUP,
+	PGDS_PHASE_VIEW_EXPANSION,
+	PGDS_PHASE_STATS_CHECK,
+	PGDS_PHASE_ANALYZE,
+	PGDS_PHASE_COUNT
+} pgdsPhase;
+
+static const char *const pgds_phase_names[PGDS_PHASE_COUNT] = {
+	"tree walk",
+	"catalog lookup",
+	"view expansion",
+	"stats check",
+	"analyze"
+};
+
+#define	PGDS_HIST_BUCKETS	32
+
+typedef struct pgdsBackendStats
+{
+	pg_atomic_uint64 counters[PGDS_STAT_COUNT];
+	pg_atomic_uint64 histograms[PGDS_PHASE_COUNT][PGDS_HIST_BUCKETS];
+} pgdsBackendStats;
+
+/*
+ * pg_stat_pgds_relations counters
+ */
+typedef struct pgdsRelStatCounters
+{
+	int64		checks;
+	int64		missing;
+	int64		stale;		/* found with quick statistics only */
+	int64		analyses;
+	double		total_analyze_time;	/* ms */
+	double		max_analyze_time;	/* ms */
+	int64		rows_sampled;	/* estimated by pgds_rows_sampled */
+	uint64		last_queryid;
+} pgdsRelStatCounters;
+
+#if PG_VERSION_NUM >= 180000
+/*
+ * custom cumulative statistics kind: ids are assigned on
+ * https://wiki.postgresql.org/wiki/CustomCumulativeStats, pgds uses the
+ * experimental id until it has one
+ */
+#define	PGSTAT_KIND_PGDS	PGSTAT_KIND_EXPERIMENTAL
+
+typedef struct PgStatShared_PgdsRel
+{
+	PgStatShared_Common header;
+	pgdsRelStatCounters stats;
+} PgStatShared_PgdsRel;
+#else
+/*
+ * shared hash of relation counters, dumped to PGDS_DUMP_FILE at shutdown
+ */
+#define	PGDS_DUMP_FILE		PGSTAT_STAT_PERMANENT_DIRECTORY "/pgds.stat"
+#define	PGDS_DUMP_HEADER	0x70676473
+#define	PGDS_DUMP_VERSION	2
+
+typedef struct pgdsRelStatKey
+{
+	Oid		dboid;
+	Oid		relid;
+} pgdsRelStatKey;
+
+typedef struct pgdsRelStatEntry
+{
+	pgdsRelStatKey	key;
+	slock_t		mutex;
+	pgdsRelStatCounters counters;
+} pgdsRelStatEntry;
+
+static HTAB *pgds_relstat_hash = NULL;
+static int pgds_max_relations = 5000;
+#endif
+
+/* queryId of statement being processed by pgds_analyze */
+static uint64 pgds_current_queryid = 0;
+
+/*
+ * relations being analyzed inline: slot is released at end of the
+ * transaction running ANALYZE so that waiters see committed statistics
+ */
+#define	MAX_INFLIGHT	64
+
+typedef struct pgdsInflight
+{
+	Oid		dboid;
+	Oid		relid;
+	int		pid;
+} pgdsInflight;
+
+/* slots claimed by this backend */
+static int pgds_inflight_claimed[MAX_INFLIGHT];
+static int pgds_inflight_nclaimed = 0;
+
+static int pgds_analyze_wait_timeout = 10000;
+
+/*
+ * pgds.mode: sync runs ANALYZE in the backend parsing the statement,
+ * async queues it for a background worker
+ */
+typedef enum pgdsMode
+{
+	PGDS_MODE_OFF,
+	PGDS_MODE_SYNC,
+	PGDS_MODE_ASYNC
+} pgdsMode;
+
+static const struct config_enum_entry pgds_mode_options[] = {
+	{"off", PGDS_MODE_OFF, false},
+	{"sync", PGDS_MODE_SYNC, false},
+	{"async", PGDS_MODE_ASYNC, false},
+	{NULL, 0, false}
+};
+
+static int pgds_mode = PGDS_MODE_SYNC;
+
+/* work items queued by current statement in async mode */
+static bool pgds_async_pending = false;
+
+/*
+ * circuit breaker: pgds is disabled for pgds_breaker_cooldown seconds after
+ * pgds_breaker_threshold consecutive failures, a relation is skipped for
+ * the same time after pgds_breaker_threshold failures on it
+ */
+#define	PGDS_BREAKER_RELS	128
+
+typedef struct pgdsBreakerRel
+{
+	Oid		dboid;
+	Oid		relid;
+	int		failures;
+	TimestampTz	open_until;
+} pgdsBreakerRel;
+
+static int pgds_breaker_threshold = 5;
+static int pgds_breaker_cooldown = 60;
+
+/* relation being processed, for failure accounting */
+static Oid pgds_current_relid = InvalidOid;
+
+/* pgds background worker: pgds_avoid_recursion is never reset */
+static bool pgds_is_worker = false;
+/* pgds background worker holding a drainer slot */
+static bool pgds_is_drainer = false;
+
+/*
+ * standby demand ring: relations found without statistics by queries run
+ * on a hot standby. Oldest entry is overwritten when ring is full.
+ * The demand worker of the primary pulls it with libpq and acknowledges
+ * the entries it has queued.
+ */
+#define	PGDS_DEMAND_RING	1024
+
+typedef struct pgdsDemand
+{
+	Oid		dboid;
+	Oid		relid;
+	Oid		relowner;
+	int64		demands;
+	TimestampTz	last_demand;
+} pgdsDemand;
+
+static char *pgds_standby_conninfo = NULL;
+static int pgds_standby_poll_interval = 60;
+
+/*
+ * indexes checked by this backend: access method and table size at last check
+ */
+typedef struct pgdsIndexChecked
+{
+	Oid		indexoid;
+	Oid		relam;
+	BlockNumber	nblocks;
+	BlockNumber	pages_per_range;	/* BRIN only */
+} pgdsIndexChecked;
+
+static HTAB *pgds_index_cache = NULL;
+/* tables having no BRIN or GIN index */
+static HTAB *pgds_noindex_cache = NULL;
+static int pgds_brin_summarize_ranges = 8;
+static int pgds_gin_pending_pages = 128;
+
+/*
+ * visibility map maintenance: tables smaller than PGDS_VACUUM_MIN_PAGES are
+ * ignored, a table is considered for VACUUM at most every
+ * PGDS_VACUUM_REQUEUE_MS in the cluster. Last PGDS_VACUUM_QUEUED tables
+ * are remembered in shared memory.
+ */
+#define	PGDS_VACUUM_MIN_PAGES	128
+#define	PGDS_VACUUM_REQUEUE_MS	(10 * 60 * 1000)
+#define	PGDS_VACUUM_QUEUED	256
+
+typedef struct pgdsVacuumQueued
+{
+	Oid		dboid;
+	Oid		relid;
+	TimestampTz	queued_at;
+} pgdsVacuumQueued;
+
+static double pgds_vacuum_visible_fraction = 0.5;
+/* worker memory context of VACUUM parse tree */
+static MemoryContext pgds_vacuum_context = NULL;
+
+/*
+ * quick statistics: histogram bounds of leading column of btree indexes of
+ * a large table without statistics are read from pivot keys of upper index
+ * levels (at most PGDS_QUICK_STATS_PAGES pages per index) while ANALYZE is
+ * queued. Provisional relations are kept until a worker has analyzed them
+ * and saved to PGDS_PROVISIONAL_FILE whenever they change.
+ */
+#define	PGDS_QUICK_STATS_PAGES	256
+#define	PGDS_PROVISIONAL	64
+#define	PGDS_PROVISIONAL_FILE	PGSTAT_STAT_PERMANENT_DIRECTORY "/pgds_provisional.stat"
+#define	PGDS_PROVISIONAL_HEADER	0x70677071
+
+typedef struct pgdsProvisional
+{
+	Oid		dboid;
+	Oid		relid;
+	int		ncolumns;
+	TimestampTz	created;
+} pgdsProvisional;
+
+static int pgds_quick_stats_min_pages = 1000;
+
+/*
+ * governor of pgds analyses: cluster-wide token bucket of sampled pages
+ * refilled at pgds.io_pages_per_second (an analysis may start while the
+ * bucket is not empty and is charged its sampled pages, leaving it in debt),
+ * number of running analyses and load thresholds deferring analyses
+ */
+#define	PGDS_GOVERNOR_NAPTIME	1000	/* ms */
+/* backend waits at most this long in pgds_prewarm_from_statements */
+#define	PGDS_GOVERNOR_MAX_WAIT	60000	/* ms */
+/* load sampled by workers: older samples are unknown load */
+#define	PGDS_LOAD_MAX_AGE	10000	/* ms */
+#define	PGDS_LOAD_BACKENDS	0x01
+#define	PGDS_LOAD_CHECKPOINT	0x02
+#define	PGDS_LOAD_LAG		0x04
+/* checkpoint was also seen by previous sample */
+#define	PGDS_LOAD_CHECKPOINT_PREV 0x08
+
+static int pgds_io_pages_per_second = 0;
+static int pgds_max_concurrent_analyses = 0;
+static int pgds_defer_active_backends = 0;
+static bool pgds_defer_during_checkpoint = false;
+static int pgds_defer_replication_lag = 0;
+/* this process counts in running analyses since subtransaction pgds_governor_subid */
+static bool pgds_governor_held = false;
+static SubTransactionId pgds_governor_subid = InvalidSubTransactionId;
+
+/*
+ * observed rows of set returning functions: argshash is 0 for all calls
+ * of funcid, else hash of constant arguments of the call. Entries are
+ * updated under shared lock and entry mutex, the least recently called one
+ * is evicted when hash is full.
+ */
+#define	PGDS_FUNC_ROWS		1000
+/* rows is the mean of at most PGDS_FUNC_ROWS_WINDOW last calls */
+#define	PGDS_FUNC_ROWS_WINDOW	8
+
+typedef struct pgdsFuncRowsKey
+{
+	Oid		dboid;
+	Oid		funcid;
+	uint32		argshash;
+} pgdsFuncRowsKey;
+
+typedef struct pgdsFuncRowsEntry
+{
+	pgdsFuncRowsKey	key;
+	slock_t		mutex;
+	double		rows;
+	int64		calls;
+	TimestampTz	last_call;
+} pgdsFuncRowsEntry;
+
+static HTAB *pgds_funcrows_hash = NULL;
+static bool pgds_function_rows = true;
+
+/*
+ * observed rows of foreign table scans: qualhash is 0 for scans without
+ * restriction clauses, else hash of their restriction clauses. Entries are
+ * updated like function rows entries.
+ */
+#define	PGDS_FOREIGN_ROWS	1000
+
+typedef struct pgdsForeignRowsKey
+{
+	Oid		dboid;
+	Oid		relid;
+	uint32		qualhash;
+} pgdsForeignRowsKey;
+
+typedef struct pgdsForeignRowsEntry
+{
+	pgdsForeignRowsKey key;
+	slock_t		mutex;
+	double		rows;
+	int64		scans;
+	TimestampTz	last_scan;
+} pgdsForeignRowsEntry;
+
+static HTAB *pgds_foreignrows_hash = NULL;
+static bool pgds_foreign_rows = true;
+/* foreign tables are analyzed by workers only, with this sample size */
+static int pgds_foreign_sample_rows = 3000;
+
+/*
+ * event ring: entry seq is 0 while entry is written, position + 1 when valid
+ */
+#define	PGDS_EVENT_RING	4096
+
+typedef enum pgdsEventAction
+{
+	PGDS_EVENT_STATEMENT = 0,
+	PGDS_EVENT_HAS_STATS,
+	PGDS_EVENT_NOT_OWNER,
+	PGDS_EVENT_VIEW_EXPANSION,
+	PGDS_EVENT_ANALYZE_WAIT,
+	PGDS_EVENT_ANALYZE,
+	PGDS_EVENT_QUEUED,
+	PGDS_EVENT_STANDBY_DEMAND,
+	PGDS_EVENT_BRIN_SUMMARIZE,
+	PGDS_EVENT_GIN_CLEAN,
+	PGDS_EVENT_VACUUM,
+	PGDS_EVENT_QUICK_STATS,
+	PGDS_EVENT_GOVERNOR_WAIT,
+	PGDS_EVENT_ANALYZE_FAILED,
+	PGDS_EVENT_COUNT
+} pgdsEventAction;
+
+static const char *const pgds_event_names[PGDS_EVENT_COUNT] = {
+	"statement",
+	"has stats",
+	"not owner",
+	"view expansion",
+	"analyze wait",
+	"analyze",
+	"queued",
+	"standby demand",
+	"brin summarize",
+	"gin clean",
+	"vacuum",
+	"quick stats",
+	"governor wait",
+	"analyze failed"
+};
+
+typedef struct pgdsEvent
+{
+	pg_atomic_uint64 seq;
+	TimestampTz	ts;
+	int		pid;
+	int		action;
+	Oid		dboid;
+	Oid		relid;
+	uint64		queryid;
+	int64		duration_us;
+} pgdsEvent;
+
+static double pgds_event_sample_rate = 1.0;
+/* current statement events are recorded */
+static bool pgds_event_sampled = true;
+
+/* wait events */
+static uint32 pgds_we_analyze_wait = 0;
+static uint32 pgds_we_inline_analyze = 0;
+static uint32 pgds_we_view_expansion = 0;
+static uint32 pgds_we_demand_pull = 0;
+static uint32 pgds_we_governor_wait = 0;
+
 typedef struct pgdsSharedState
 {
 	LWLock 		*lock;
-	
+	LWLock		*relstat_lock;
+	LWLock		*funcrows_lock;
+	LWLock		*foreignrows_lock;
+	pgdsWorkItem	work[MAX_WORK_ITEMS];
+	pgdsDrainer	drainers[PGDS_DRAINERS];
+	uint64		stats_reset_base[PGDS_STAT_COUNT];
+	uint64		histograms_reset_base[PGDS_PHASE_COUNT][PGDS_HIST_BUCKETS];
+	TimestampTz	stats_reset;
+	ConditionVariable inflight_cv;
+	pgdsInflight	inflight[MAX_INFLIGHT];
+	pg_atomic_uint64 event_pos;
+	pgdsEvent	events[PGDS_EVENT_RING];
+	pg_atomic_uint32 breaker_failures;
+	pg_atomic_uint64 breaker_open_until;
+	pg_atomic_uint32 breaker_nrels;
+	pgdsBreakerRel	breaker_rels[PGDS_BREAKER_RELS];
+	int		demand_next;
+	pgdsDemand	demand[PGDS_DEMAND_RING];
+	pgdsProvisional	provisional[PGDS_PROVISIONAL];
+	pgdsVacuumQueued vacuum_queued[PGDS_VACUUM_QUEUED];
+	slock_t		governor_mutex;
+	double		io_tokens;	/* sampled pages that may be read, negative when in debt */
+	TimestampTz	io_refill;	/* last refill of io_tokens, 0 before first analysis */
+	int		running;	/* running analyses */
+	pg_atomic_uint32 load_flags;	/* PGDS_LOAD_* of last load sample */
+	pg_atomic_uint64 load_sampled;	/* time of last load sample, 0 before first one */
 } pgdsSharedState;
 
 static pgdsSharedState *pgds = NULL;
 
+/* per backend slots: last slot is shared by processes without backend slot */
+static pgdsBackendStats *pgds_backend_stats = NULL;
+static int pgds_nslots = 0;
+
+/*
+ * relations known to have statistics: entries are removed by relcache
+ * invalidation. Number of blocks used by the VACUUM check of
+ * pgds_cached_table is read again after PGDS_NBLOCKS_RECHECK.
+ */
+#define	PGDS_NBLOCKS_RECHECK	10000	/* ms */
+
+typedef struct pgdsStatsCached
+{
+	Oid		relid;
+	BlockNumber	nblocks;
+	TimestampTz	sized;		/* 0 until nblocks is read */
+} pgdsStatsCached;
+
+static HTAB *pgds_stats_cache = NULL;
+
 #define	MAX_REL	1024
 static 	Oid pgds_rel_array[MAX_REL] = {};
 static	int	pgds_rel_index = 0;
 
+/* SQL functions called by statement: their bodies are walked before processing relations */
+#define	MAX_FUNC	256
+static	Oid pgds_func_array[MAX_FUNC] = {};
+static	int	pgds_func_index = 0;
+
+/*
+ * relations and functions referenced by body of SQL function, cached per
+ * backend: entries are removed by invalidation of function or of one of its
+ * relations. Function text is parsed with search_path in effect.
+ */
+typedef struct pgdsFuncRels
+{
+	Oid		funcid;
+	uint32		hashvalue;	/* PROCOID syscache hash value */
+	char		*search_path;
+	List		*rels;
+	List		*funcs;
+} pgdsFuncRels;
+
+static HTAB *pgds_func_cache = NULL;
+static bool pgds_func_capture = false;
+static List *pgds_func_capture_rels = NIL;
+static List *pgds_func_capture_funcs = NIL;
+/* query string whose statements following offset pgds_lookahead_from have been added */
+static const char *pgds_lookahead_source = NULL;
+static int pgds_lookahead_from = 0;
+/* database has SQL functions created by users: -1 until known, reset by PROCOID invalidation */
+static int pgds_user_sql_functions = -1;
+
 #define MAX_TABLE	10*MAX_REL
 static 	Oid pgds_tableoid_array[MAX_TABLE] = {};
 static 	char *pgds_tablename_array[MAX_TABLE] = {};
 static 	Oid pgds_tableowner_array[MAX_TABLE] = {};
+static 	bool pgds_tableforeign_array[MAX_TABLE] = {};
+/* result of batched pg_statistic probe, -1 if table was not probed */
+static 	int64 pgds_tableprobe_array[MAX_TABLE] = {};
 static	int pgds_table_index = 0;
 
 /* Saved hook values in case of unload */
@@ -83,9 +696,49 @@ static shmem_request_hook_type prev_shmem_request_hook = NULL;
 #endif
 static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
 static post_parse_analyze_hook_type prev_post_parse_analyze_hook = NULL;
+static ExecutorStart_hook_type prev_ExecutorStart = NULL;
+static ExecutorEnd_hook_type prev_ExecutorEnd = NULL;
+static set_rel_pathlist_hook_type prev_set_rel_pathlist_hook = NULL;
+#if PG_VERSION_NUM >= 180000
+static explain_per_plan_hook_type prev_explain_per_plan_hook = NULL;
+static int pgds_explain_id = 0;
+#elif PG_VERSION_NUM >= 130000
+static ExplainOneQuery_hook_type prev_ExplainOneQuery_hook = NULL;
+#endif
+/* EXPLAIN adds pgds section: default of PGDS option with PostgreSQL 18 */
+static bool pgds_explain = false;
 
 static int pgds_avoid_recursion = 0;
 
+/*
+ * relations processed by last statement, displayed by EXPLAIN
+ */
+typedef struct pgdsExplainRel
+{
+	Oid		relid;
+	pgdsEventAction	action;
+	uint64		duration_us;
+} pgdsExplainRel;
+
+static pgdsExplainRel pgds_explain_rels[MAX_TABLE];
+static int pgds_explain_nrels = 0;
+
+/*
+ * relations and columns collected by pgds_prewarm_from_statements
+ */
+typedef struct pgdsPrewarmRel
+{
+	Oid		relid;
+	bool		all_columns;
+	Bitmapset	*attnums;
+} pgdsPrewarmRel;
+
+typedef struct pgdsPrewarmContext
+{
+	MemoryContext	mcxt;
+	List		*rels;
+} pgdsPrewarmContext;
+
 /*---- Function declarations ----*/
 
 void		_PG_init(void);
@@ -101,11 +754,103 @@ static  void    pgds_analyze(ParseState *pstate, Query *query, JumbleState *jsta
 #endif
 
 static 	void	pgds_analyze_table(int);
+static	void	pgds_batch_probe(void);
 static	void	pgds_build_rel_array(Query *);
 static	void	pgds_build_table_array();
-static  bool    pgds_tree_walker(Query *node, void *context);
-static  bool    pgds_sublink_walker(Node *node, void *context);
 static  void 	pgds_add_rel_array(Oid relid);
+static	void	pgds_prewarm_add_rte(pgdsPrewarmContext *ctx, Query *query, RangeTblEntry *rte);
+
+PGDLLEXPORT void pgds_worker_main(Datum main_arg);
+PGDLLEXPORT void pgds_demand_worker_main(Datum main_arg);
+
+static	void	pgds_count(pgdsStatCounter counter, uint64 n);
+static	void	pgds_explain_record(Oid relid, pgdsEventAction action, uint64 duration_us);
+static	char	*pgds_qualified_name(Oid relid);
+static	bool	pgds_enqueue_work(pgdsWorkItem *item);
+static	int	pgds_launch_workers(int nworkers, BackgroundWorkerHandle **handles);
+static	int	pgds_launch_workers_for(Oid dboid, Oid userid, int nworkers, BackgroundWorkerHandle **handles,
+					bool drainer);
+static	void	pgds_launch_drainer(Oid dboid, Oid userid);
+static	void	pgds_demand_record(Oid relid, Oid relowner);
+static	bool	pgds_breaker_open(Oid relid);
+static	void	pgds_breaker_failure(Oid relid);
+static	void	pgds_breaker_success(void);
+static	bool	pgds_cached_table(Oid relid);
+static	void	pgds_cache_hit(Oid relid, instr_time check_start);
+static	void	pgds_process_relations(void);
+static	void	pgds_index_check(int index);
+static	void	pgds_index_clean(pgdsWorkItem *item);
+static	void	pgds_vacuum_check(int index);
+static	void	pgds_vacuum(pgdsWorkItem *item);
+#if PG_VERSION_NUM >= 180000
+static	void	pgds_explain_option(ExplainState *es, DefElem *opt, ParseState *pstate);
+static	void	pgds_explain_per_plan(PlannedStmt *plannedstmt, IntoClause *into, ExplainState *es,
+				      const char *queryString, ParamListInfo params,
+				      QueryEnvironment *queryEnv);
+#elif PG_VERSION_NUM >= 130000
+static	void	pgds_ExplainOneQuery(Query *query, int cursorOptions, IntoClause *into,
+				     ExplainState *es, const char *queryString,
+				     ParamListInfo params, QueryEnvironment *queryEnv);
+#endif
+static	void	pgds_relcache_callback(Datum arg, Oid relid);
+static	void	pgds_func_cache_callback(Datum arg, int cacheid, uint32 hashvalue);
+static	void	pgds_statistic_callback(Datum arg, int cacheid, uint32 hashvalue);
+static	void	pgds_func_cache_forget(Oid relid, uint32 hashvalue);
+static	void	pgds_relstat_report(Oid relid, int64 checks, int64 missing, int64 stale,
+				    int64 analyses, double analyze_time, int64 rows_sampled);
+static	int64	pgds_rows_sampled(Oid relid);
+#if PG_VERSION_NUM >= 180000
+static	bool	pgds_relstat_flush_cb(PgStat_EntryRef *entry_ref, bool nowait);
+
+static const PgStat_KindInfo pgds_relstat_kind = {
+	.name = "pgds",
+	.fixed_amount = false,
+	.write_to_file = true,
+	.shared_size = sizeof(PgStatShared_PgdsRel),
+	.shared_data_off = offsetof(PgStatShared_PgdsRel, stats),
+	.shared_data_len = sizeof(((PgStatShared_PgdsRel *) 0)->stats),
+	.pending_size = sizeof(pgdsRelStatCounters),
+	.flush_pending_cb = pgds_relstat_flush_cb,
+};
+#else
+static	void	pgds_relstat_load(void);
+static	void	pgds_relstat_dump(void);
+#endif
+static	void	pgds_provisional_load(void);
+static	void	pgds_provisional_save(void);
+
+PG_FUNCTION_INFO_V1(pgds_prewarm_from_statements);
+PG_FUNCTION_INFO_V1(pgds_export_stats);
+PG_FUNCTION_INFO_V1(pgds_import_stats);
+PG_FUNCTION_INFO_V1(pgds_stat);
+PG_FUNCTION_INFO_V1(pgds_stat_reset);
+PG_FUNCTION_INFO_V1(pgds_relation_stats);
+PG_FUNCTION_INFO_V1(pgds_relation_stats_reset);
+PG_FUNCTION_INFO_V1(pgds_latency_histogram);
+PG_FUNCTION_INFO_V1(pgds_events);
+PG_FUNCTION_INFO_V1(pgds_walker_bench);
+PG_FUNCTION_INFO_V1(pgds_standby_demand);
+PG_FUNCTION_INFO_V1(pgds_standby_demand_ack);
+PG_FUNCTION_INFO_V1(pgds_function_rows);
+PG_FUNCTION_INFO_V1(pgds_function_rows_reset);
+PG_FUNCTION_INFO_V1(pgds_foreign_rows);
+PG_FUNCTION_INFO_V1(pgds_foreign_rows_reset);
+PG_FUNCTION_INFO_V1(pgds_provisional_stats);
+PG_FUNCTION_INFO_V1(pgds_governor);
+
+/*
+ * number of per backend statistics slots
+ */
+static int
+pgds_max_backends(void)
+{
+#if PG_VERSION_NUM >= 150000
+	return MaxBackends;
+#else
+	/* MaxBackends is not yet computed when shared memory is requested */
+	return MaxConnections + autovacuum_max_workers + 1 + max_worker_processes + max_wal_senders;
+#endif
+}
 
 /*
  *  Estimate shared memory space needed.
@@ -116,7 +861,13 @@ pgds_memsize(void)
 {
 	Size		size;
 
-	size = 1024;
+	size = MAXALIGN(sizeof(pgdsSharedState));
+	size = add_size(size, mul_size(pgds_max_backends() + 1, sizeof(pgdsBackendStats)));
+#if PG_VERSION_NUM < 180000
+	size = add_size(size, hash_estimate_size(pgds_max_relations, sizeof(pgdsRelStatEntry)));
+#endif
+	size = add_size(size, hash_estimate_size(PGDS_FUNC_ROWS, sizeof(pgdsFuncRowsEntry)));
+	size = add_size(size, hash_estimate_size(PGDS_FOREIGN_ROWS, sizeof(pgdsForeignRowsEntry)));
 
 	return size;
 }
@@ -141,7 +892,7 @@ pgds_shmem_request(void)
 
 	RequestAddinShmemSpace(pgds_memsize());
 #if PG_VERSION_NUM >= 90600
-	RequestNamedLWLockTranche("pgds", 1);
+	RequestNamedLWLockTranche("pgds", 4);
 #endif
 
 }
@@ -171,16 +922,86 @@ pgds_shmem_startup(void)
 				pgds_memsize(),
 			        &found);
 
+	pgds_nslots = pgds_max_backends() + 1;
+	pgds_backend_stats = (pgdsBackendStats *) ((char *) pgds + MAXALIGN(sizeof(pgdsSharedState)));
+
 	if (!found)
 	{
+		int	i;
+		int	j;
+
 		/* First time through ... */
 #if PG_VERSION_NUM <= 90600
 		RequestAddinLWLocks(1);
 		pgds->lock = LWLockAssign();
 #else
-		pgds->lock = &(GetNamedLWLockTranche("pgds"))->lock;
+		pgds->lock = &(GetNamedLWLockTranche("pgds"))[0].lock;
+		pgds->relstat_lock = &(GetNamedLWLockTranche("pgds"))[1].lock;
+		pgds->funcrows_lock = &(GetNamedLWLockTranche("pgds"))[2].lock;
+		pgds->foreignrows_lock = &(GetNamedLWLockTranche("pgds"))[3].lock;
+#endif
+		memset(pgds->work, 0, sizeof(pgds->work));
+		memset(pgds->drainers, 0, sizeof(pgds->drainers));
+		memset(pgds->stats_reset_base, 0, sizeof(pgds->stats_reset_base));
+		memset(pgds->histograms_reset_base, 0, sizeof(pgds->histograms_reset_base));
+		pgds->stats_reset = GetCurrentTimestamp();
+		ConditionVariableInit(&pgds->inflight_cv);
+		memset(pgds->inflight, 0, sizeof(pgds->inflight));
+		pg_atomic_init_u64(&pgds->event_pos, 0);
+		pg_atomic_init_u32(&pgds->breaker_failures, 0);
+		pg_atomic_init_u64(&pgds->breaker_open_until, 0);
+		pg_atomic_init_u32(&pgds->breaker_nrels, 0);
+		memset(pgds->breaker_rels, 0, sizeof(pgds->breaker_rels));
+		pgds->demand_next = 0;
+		memset(pgds->demand, 0, sizeof(pgds->demand));
+		memset(pgds->provisional, 0, sizeof(pgds->provisional));
+		memset(pgds->vacuum_queued, 0, sizeof(pgds->vacuum_queued));
+		SpinLockInit(&pgds->governor_mutex);
+		pgds->io_tokens = 0;
+		pgds->io_refill = 0;
+		pgds->running = 0;
+		pg_atomic_init_u32(&pgds->load_flags, 0);
+		pg_atomic_init_u64(&pgds->load_sampled, 0);
+		for (i = 0; i < PGDS_EVENT_RING; i++)
+			pg_atomic_init_u64(&pgds->events[i].seq, 0);
+		for (i = 0; i < pgds_nslots; i++)
+		{
+			for (j = 0; j < PGDS_STAT_COUNT; j++)
+				pg_atomic_init_u64(&pgds_backend_stats[i].counters[j], 0);
+			for (j = 0; j < PGDS_PHASE_COUNT * PGDS_HIST_BUCKETS; j++)
+				pg_atomic_init_u64(&pgds_backend_stats[i].histograms[j / PGDS_HIST_BUCKETS][j % PGDS_HIST_BUCKETS], 0);
+		}
+
+	}
+
+#if PG_VERSION_NUM < 180000
+	{
+		HASHCTL		info;
+
+		memset(&info, 0, sizeof(info));
+		info.keysize = sizeof(pgdsRelStatKey);
+		info.entrysize = sizeof(pgdsRelStatEntry);
+		pgds_relstat_hash = ShmemInitHash("pgds relation statistics",
+						  pgds_max_relations, pgds_max_relations,
+						  &info, HASH_ELEM | HASH_BLOBS);
+	}
 #endif
+	{
+		HASHCTL		info;
+
+		memset(&info, 0, sizeof(info));
+		info.keysize = sizeof(pgdsFuncRowsKey);
+		info.entrysize = sizeof(pgdsFuncRowsEntry);
+		pgds_funcrows_hash = ShmemInitHash("pgds function rows",
+						   PGDS_FUNC_ROWS, PGDS_FUNC_ROWS,
+						   &info, HASH_ELEM | HASH_BLOBS);
 
+		memset(&info, 0, sizeof(info));
+		info.keysize = sizeof(pgdsForeignRowsKey);
+		info.entrysize = sizeof(pgdsForeignRowsEntry);
+		pgds_foreignrows_hash = ShmemInitHash("pgds foreign rows",
+						      PGDS_FOREIGN_ROWS, PGDS_FOREIGN_ROWS,
+						      &info, HASH_ELEM | HASH_BLOBS);
 	}
 
 	LWLockRelease(AddinShmemInitLock);
@@ -201,7 +1022,10 @@ pgds_shmem_startup(void)
 	if (found)
 		return;
 
-
+#if PG_VERSION_NUM < 180000
+	pgds_relstat_load();
+#endif
+	pgds_provisional_load();
 }
 
 /*
@@ -224,405 +1048,7232 @@ pgds_shmem_shutdown(int code, Datum arg)
 	if (!pgds)
 		return;
 	
-	/* currently: no action */
+#if PG_VERSION_NUM < 180000
+	pgds_relstat_dump();
+#endif
+	pgds_provisional_save();
 
 	elog(DEBUG5, "pgds: pgds_shmem_shutdown: exit");
 }
 
 
 /*
- * Module load callback
+ * pgds_count
+ *
+ * increment counter in this backend slot: no other process writes to it
  */
-void
-_PG_init(void)
+static void
+pgds_count(pgdsStatCounter counter, uint64 n)
 {
-	elog(DEBUG5, "pgds:_PG_init():entry");
+	pgdsBackendStats *slot;
+	int	slotno;
 
-	if (!process_shared_preload_libraries_in_progress)
+	if (pgds_backend_stats == NULL)
 		return;
 
-	elog(LOG, "pgds:_PG_init(): pgds is enabled ");
-
-#if PG_VERSION_NUM >= 150000
-	prev_shmem_request_hook = shmem_request_hook;
-	shmem_request_hook = pgds_shmem_request;
+#if PG_VERSION_NUM >= 170000
+	slotno = MyProcNumber;
 #else
-	pgds_shmem_request();
+	slotno = MyBackendId - 1;
 #endif
-	prev_shmem_startup_hook = shmem_startup_hook;
-	shmem_startup_hook = pgds_shmem_startup;
-
-	prev_post_parse_analyze_hook = post_parse_analyze_hook;
-	post_parse_analyze_hook = pgds_analyze;
+	if (slotno < 0 || slotno >= pgds_nslots - 1)
+	{
+		/* shared overflow slot */
+		pg_atomic_fetch_add_u64(&pgds_backend_stats[pgds_nslots - 1].counters[counter], n);
+		return;
+	}
 
-	elog(DEBUG5, "pgds:_PG_init():exit");
+	slot = &pgds_backend_stats[slotno];
+	pg_atomic_write_u64(&slot->counters[counter],
+			    pg_atomic_read_u64(&slot->counters[counter]) + n);
 }
 
-
 /*
- *  Module unload callback
+ * pgds_phase_record
+ *
+ * add duration of phase started at start to this backend histogram:
+ * returns duration in microseconds
  */
-void
-_PG_fini(void)
+static uint64
+pgds_phase_record(pgdsPhase phase, instr_time start)
 {
-	shmem_startup_hook = prev_shmem_startup_hook;	
-	post_parse_analyze_hook = prev_post_parse_analyze_hook;
-}
+	instr_time	duration;
+	uint64		us;
+	uint64		v;
+	int		bucket = 0;
+	pgdsBackendStats *slot;
+	int		slotno;
 
-static void pgds_add_rel_array(Oid relid)
-{
-	bool found = false;
-	int i;
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	us = INSTR_TIME_GET_MICROSEC(duration);
 
-	/*
-	 * tree walkers may find same relation several times
-	 */
-	for (i = 0 ; i < pgds_rel_index; i++)
+	if (pgds_backend_stats == NULL)
+		return us;
+
+	for (v = us; v > 0 && bucket < PGDS_HIST_BUCKETS - 1; v >>= 1)
+		bucket++;
+
+#if PG_VERSION_NUM >= 170000
+	slotno = MyProcNumber;
+#else
+	slotno = MyBackendId - 1;
+#endif
+	if (slotno < 0 || slotno >= pgds_nslots - 1)
 	{
-		if (pgds_rel_array[i] == relid) 
-		{
-			found = true;
-			break;
-		}
+		pg_atomic_fetch_add_u64(&pgds_backend_stats[pgds_nslots - 1].histograms[phase][bucket], 1);
+		return us;
 	}
-	if (found == true)
-		return;
 
-	if (pgds_rel_index < MAX_REL )
-	{
-		pgds_rel_array[pgds_rel_index] = relid;
-		pgds_rel_index++;
-	} 
-	else elog(ERROR, "pgds_add_rel_array: too many relations (%d)", MAX_REL);
+	slot = &pgds_backend_stats[slotno];
+	pg_atomic_write_u64(&slot->histograms[phase][bucket],
+			    pg_atomic_read_u64(&slot->histograms[phase][bucket]) + 1);
+	return us;
 }
 
-static bool pgds_tree_walker(Query *node, void *context)
+/*
+ * pgds_event
+ *
+ * add event to shared ring: events of non sampled statements are only
+ * recorded if force is true
+ */
+static void
+pgds_event(pgdsEventAction action, Oid relid, int64 duration_us, bool force)
 {
-	/*
-	 *  Note to self: full list of node tags are only in *compiled* src/include/nodes/nodes.h
-	 */
-
-	 ListCell   *l;
+	uint64		pos;
+	pgdsEvent	*ev;
 
-	// elog(INFO, "pgds_tree_walker: input= %s", nodeToString(node));
-
-	/*
-	 * from rewriteHandler.c
-	 * AcquireRewriteLocks
-	 */ 
-
-	if (node == NULL)
-         return false;
-
- 	if (IsA(node, Query))
-    {
-
-         ListCell   *lc;
-  
-         foreach(lc, node->rtable)
-         {
-             RangeTblEntry *rte = (RangeTblEntry *) lfirst(lc);
-  
-             if (rte->rtekind == RTE_RELATION)
-			 {
-					// elog(INFO, "pgds_tree_walker: relid=%d", rte->relid);
-					pgds_add_rel_array(rte->relid);
-			 }
-
-			if (rte->rtekind == RTE_SUBQUERY)
-				(void)pgds_tree_walker(rte->subquery, context);
-		 }
-
-		/* Recurse into subqueries in WITH */
-    	foreach(l, node->cteList)
-    	{	
-       		 CommonTableExpr *cte = (CommonTableExpr *) lfirst(l);
-  
-       		pgds_tree_walker((Query *) cte->ctequery, context);
-    	}
-	
-	}
+	if (pgds == NULL || !(pgds_event_sampled || force))
+		return;
 
-	/*
-     * Recurse into sublink subqueries, too.  But we already did the ones in
-     * the rtable and cteList.
-     */
-    if (node->hasSubLinks)
-       	query_tree_walker(node, pgds_sublink_walker, &context,
-    		       	               QTW_IGNORE_RC_SUBQUERIES);
-		// pgds_sublink_walker((Node *)node, context);
+	pos = pg_atomic_fetch_add_u64(&pgds->event_pos, 1);
+	ev = &pgds->events[pos % PGDS_EVENT_RING];
 
+	pg_atomic_write_u64(&ev->seq, 0);
+	pg_write_barrier();
+	ev->ts = GetCurrentTimestamp();
+	ev->pid = MyProcPid;
+	ev->action = action;
+	ev->dboid = MyDatabaseId;
+	ev->relid = relid;
+	ev->queryid = pgds_current_queryid;
+	ev->duration_us = duration_us;
+	pg_write_barrier();
+	pg_atomic_write_u64(&ev->seq, pos + 1);
 }
 
-static bool pgds_sublink_walker(Node *node, void *context)
-{
-
-	//elog(INFO, "pgds_sublink_walker: input=%s", nodeToString(node));
-	/*
-	 * from rewriteHandler.c
-	 * acquireLocksOnSubLinks
-	 */
-	if (node == NULL)
-         return false;
-     if (IsA(node, SubLink))
-     {
-         SubLink    *sub = (SubLink *) node;
-  
-         /* Do what we came for */
-         pgds_tree_walker((Query *) sub->subselect,
-                             context);
-         /* Fall through to process lefthand args of SubLink */
-     }
-  
-     /*
-      * Do NOT recurse into Query nodes, because (AcquireRewriteLocks)pgds_tree_walker already
-      * processed subselects of subselects for us.
-      */
-     return expression_tree_walker(node, pgds_sublink_walker, context);
+/*
+ * pgds_relcache_callback
+ *
+ * forget cached statistics existence of invalidated relations
+ */
+static void
+pgds_relcache_callback(Datum arg, Oid relid)
+{
+	/* relation rules or policies may have changed */
+	pgds_func_cache_forget(relid, 0);
+
+	if (pgds_noindex_cache != NULL)
+	{
+		if (OidIsValid(relid))
+			(void) hash_search(pgds_noindex_cache, &relid, HASH_REMOVE, NULL);
+		else
+		{
+			hash_destroy(pgds_noindex_cache);
+			pgds_noindex_cache = NULL;
+		}
+	}
+
+	/* index may have been dropped or rebuilt */
+	if (pgds_index_cache != NULL)
+	{
+		if (OidIsValid(relid))
+			(void) hash_search(pgds_index_cache, &relid, HASH_REMOVE, NULL);
+		else
+		{
+			hash_destroy(pgds_index_cache);
+			pgds_index_cache = NULL;
+		}
+	}
+
+	if (pgds_stats_cache == NULL)
+		return;
 
+	if (OidIsValid(relid))
+		(void) hash_search(pgds_stats_cache, &relid, HASH_REMOVE, NULL);
+	else
+	{
+		hash_destroy(pgds_stats_cache);
+		pgds_stats_cache = NULL;
+	}
 }
 
 /*
- * build_rel_array
+ * pgds_statistic_callback
+ *
+ * pg_statistic rows have changed: statistics may have been deleted
+ * without relcache invalidation of their relation, for example by a
+ * column type change. Hash value does not give relation: whole cache is
+ * forgotten.
  */
-static void pgds_build_rel_array(Query *query)
+static void
+pgds_statistic_callback(Datum arg, int cacheid, uint32 hashvalue)
 {
-	void *context = NULL;
+	if (pgds_stats_cache == NULL)
+		return;
 
-	(void)pgds_tree_walker(query, context);
+	hash_destroy(pgds_stats_cache);
+	pgds_stats_cache = NULL;
 }
 
+/*
+ * pgds_stats_cache_lookup
+ */
+static bool
+pgds_stats_cache_lookup(Oid relid)
+{
+	if (pgds_stats_cache == NULL)
+		return false;
+
+	return (hash_search(pgds_stats_cache, &relid, HASH_FIND, NULL) != NULL);
+}
 
 /*
- *   pgds_get_rel_details
+ * pgds_stats_cache_insert
  */
-static void pgds_get_rel_details(Oid rel_id, char **relname, char** relkind, Oid *relowner)
+static void
+pgds_stats_cache_insert(Oid relid)
 {
-	StringInfoData buf_select;	
-	SPITupleTable *tuptable;
-	TupleDesc tupdesc;
-	int ret;
-	int nr;
-	bool isnull;
+	pgdsStatsCached *entry;
+	bool	found;
 
-	initStringInfo(&buf_select);
-	appendStringInfo(&buf_select, 
-				     "select relnamespace, relname, relkind, relowner from pg_class where oid = '%d'", rel_id);
-	ret = SPI_execute(buf_select.data, false, 0);
-	if (ret != SPI_OK_SELECT)
-		elog(FATAL, "cannot select from pg_class for rel_id: %d  error code: %d", rel_id, ret);
-	nr = SPI_processed;
-	if (nr == 0)
-		elog(FATAL, "rel_id: %d not found in pg_class", rel_id);
-	if (nr > 1)
-		elog(FATAL, "too many rel.: %d found in pg_class for rel_id: %d" , nr, rel_id);
-	/*
-	 * relname = column 2 for single row result
-	 * relkind = column 3 for single row result
-	 * relowner = column 4 for single row result
-	*/
-	tuptable = SPI_tuptable;
-	tupdesc = tuptable->tupdesc;
-	*relname = SPI_getvalue(tuptable->vals[0], tupdesc, 2);
-	*relkind = SPI_getvalue(tuptable->vals[0], tupdesc, 3);
-	*relowner = DatumGetInt32(SPI_getbinval(tuptable->vals[0], tupdesc, 4, &isnull));
+	if (pgds_stats_cache == NULL)
+	{
+		HASHCTL ctl;
 
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(pgdsStatsCached);
+		ctl.hcxt = TopMemoryContext;
+		pgds_stats_cache = hash_create("pgds statistics cache", 256, &ctl,
+					       HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	entry = (pgdsStatsCached *) hash_search(pgds_stats_cache, &relid, HASH_ENTER, &found);
+	if (!found)
+		entry->sized = 0;
 }
 
 /*
- * pgds_build_table_array
+ * pgds_init_wait_events
+ *
+ * custom wait events are only available with PostgreSQL 17 and later:
+ * older versions report generic Extension wait event
  */
-static void pgds_build_table_array(Oid rel_id)
+static void
+pgds_init_wait_events(void)
 {
+	if (pgds_we_analyze_wait != 0)
+		return;
 
-	StringInfoData buf_select;	
-	SPITupleTable *tuptable;
-    TupleDesc tupdesc;
-	int j;
-	int nr;
-	int ret;
-	char *relname;
-	char *relkind;
-	Oid relowner;
-	int	ref_rel_id;
-	char *ref_rel_kind;
-	char *ref_rel_name;
-	Oid ref_rel_owner;
-	bool isnull;
+#if PG_VERSION_NUM >= 170000
+	pgds_we_analyze_wait = WaitEventExtensionNew("PgdsAnalyzeWait");
+	pgds_we_inline_analyze = WaitEventExtensionNew("PgdsInlineAnalyze");
+	pgds_we_view_expansion = WaitEventExtensionNew("PgdsViewExpansion");
+	pgds_we_demand_pull = WaitEventExtensionNew("PgdsStandbyDemand");
+	pgds_we_governor_wait = WaitEventExtensionNew("PgdsGovernorWait");
+#else
+	pgds_we_analyze_wait = PG_WAIT_EXTENSION;
+	pgds_we_inline_analyze = PG_WAIT_EXTENSION;
+	pgds_we_view_expansion = PG_WAIT_EXTENSION;
+	pgds_we_demand_pull = PG_WAIT_EXTENSION;
+	pgds_we_governor_wait = PG_WAIT_EXTENSION;
+#endif
+}
 
-	if (rel_id == 0)
-		return;
+/*
+ * pgds_inflight_claim
+ *
+ * mark relid as being analyzed by this backend: returns false if another
+ * backend is already analyzing it. If no slot is free relation is not tracked.
+ */
+static bool
+pgds_inflight_claim(Oid relid)
+{
+	int i;
+	int free_slot = -1;
 
-	pgds_get_rel_details(rel_id, &relname, &relkind, &relowner);
-	elog(LOG, "pgds_build_table_array: reld_id=%d relname=%s, relkind=%s relwoner=%d", rel_id, relname, relkind, relowner);
+	if (pgds == NULL)
+		return true;
 
-	if (strcmp(relkind, "r") == 0 || strcmp(relkind, "p") == 0)
-	{
-			if (pgds_table_index < MAX_TABLE)
-			{
-				pgds_tableoid_array[pgds_table_index] = rel_id;
-				pgds_tablename_array[pgds_table_index] = relname;
-				pgds_tableowner_array[pgds_table_index] = relowner;
-				pgds_table_index++;
-			} 
-			else elog(ERROR, "pgds_build_table_array: too many tables(%d)", MAX_TABLE);
-	} 
-	else if (strcmp(relkind, "v") == 0)
+	LWLockAcquire(pgds->lock, LW_EXCLUSIVE);
+	for (i = 0; i < MAX_INFLIGHT; i++)
 	{
-		/*
-		 * search relations referenced by rel_id view
-		 */	
-		initStringInfo(&buf_select);
-		appendStringInfo(&buf_select, 
-					    "SELECT * from find_tables(%d)", rel_id);
-		ret = SPI_execute(buf_select.data, false, 0);
-		if (ret != SPI_OK_SELECT)
-			elog(FATAL, "cannot get dependant relations for rel_id %d: error code: %d", rel_id, ret);
-		nr = SPI_processed;		
-		elog(LOG, "pgds_build_table_array: nr=%d", nr);
-		/*
-		 * column 1 is referenced rel_id
-		 * column 2 is referenced rel_name
-		 * column 3 is referenced rel_kind
-		 * column 4 is referenced rel_owner
-		*/
-	 	tuptable = SPI_tuptable;
-    	tupdesc = tuptable->tupdesc;
-		for (j = 0; j < nr; j++)
+		pgdsInflight *slot = &pgds->inflight[i];
+
+		if (slot->pid == 0)
 		{
-			elog(LOG, "pgds_build_table_array: j=%d", j);
-			ref_rel_id = DatumGetInt32(SPI_getbinval(tuptable->vals[j],
-							  tupdesc, 1, &isnull));
-			ref_rel_name = SPI_getvalue(tuptable->vals[j],
-							  tupdesc, 2);
-			ref_rel_kind = SPI_getvalue(tuptable->vals[j],
-							  tupdesc, 3);
-			ref_rel_owner = DatumGetInt32(SPI_getbinval(tuptable->vals[j],
-							  tupdesc, 4, &isnull));
-			if (strcmp(ref_rel_kind,"r") == 0 && ref_rel_id != 0)
-			{
-					if (pgds_table_index < MAX_TABLE)
-					{
-						pgds_tableoid_array[pgds_table_index] = ref_rel_id;
-						pgds_tablename_array[pgds_table_index] = ref_rel_name;
-						pgds_tableowner_array[pgds_table_index] = ref_rel_owner;
-						pgds_table_index++;
-					} else elog(ERROR, "pgds_build_table_array: too many tables(%d)", MAX_TABLE);
-			}
+			if (free_slot < 0)
+				free_slot = i;
+			continue;
+		}
+		if (slot->dboid == MyDatabaseId && slot->relid == relid)
+		{
+			LWLockRelease(pgds->lock);
+			return (slot->pid == MyProcPid);
 		}
 	}
-	else
+	if (free_slot >= 0 && pgds_inflight_nclaimed < MAX_INFLIGHT)
 	{
-		elog(FATAL, "unexpected rel_type: %s for rel_id: %d", relkind, rel_id);
+		pgds->inflight[free_slot].dboid = MyDatabaseId;
+		pgds->inflight[free_slot].relid = relid;
+		pgds->inflight[free_slot].pid = MyProcPid;
+		pgds_inflight_claimed[pgds_inflight_nclaimed++] = free_slot;
 	}
+	LWLockRelease(pgds->lock);
 
+	return true;
 }
 
-
 /*
+ * pgds_inflight_release
  *
- * pgds_analyze: main routine
- *
+ * release claim of relid by this backend before end of transaction
  */
-#if PG_VERSION_NUM < 140000
-static void pgds_analyze(ParseState *pstate, Query *query)
-#else
-static void pgds_analyze(ParseState *pstate, Query *query, JumbleState *js)
-#endif
+static void
+pgds_inflight_release(Oid relid)
 {
 	int i;
+	int j;
 
-	elog(DEBUG1,"pgds: pgds_analyze: entry: %s",pstate->p_sourcetext);
-
-	/* pstate->p_sourcetext is the current query text */	
-	elog(LOG,"pgds: pgds_analyze: %s",pstate->p_sourcetext);
+	if (pgds == NULL)
+		return;
 
-	if (pgds_avoid_recursion == 0)
+	LWLockAcquire(pgds->lock, LW_EXCLUSIVE);
+	for (i = 0; i < pgds_inflight_nclaimed; i++)
 	{
-		pgds_avoid_recursion = 1;
-		SPI_connect();
-	
-		/*
-		 *  1. find all tables from all relations
-	 	 *  2. for all tables: check and gather statistics
-	 	 */
+		pgdsInflight *slot = &pgds->inflight[pgds_inflight_claimed[i]];
 
-		pgds_build_rel_array(query);
-		for (i = 0; i < pgds_rel_index; i++)
-			pgds_build_table_array(pgds_rel_array[i]);
-		for (i = 0 ; i < pgds_table_index; i++)
-			pgds_analyze_table(i);
+		if (slot->pid == MyProcPid && slot->dboid == MyDatabaseId && slot->relid == relid)
+		{
+			memset(slot, 0, sizeof(pgdsInflight));
+			for (j = i + 1; j < pgds_inflight_nclaimed; j++)
+				pgds_inflight_claimed[j - 1] = pgds_inflight_claimed[j];
+			pgds_inflight_nclaimed--;
+			break;
+		}
+	}
+	LWLockRelease(pgds->lock);
 
-		SPI_finish();
-		pgds_avoid_recursion = 0;
+	ConditionVariableBroadcast(&pgds->inflight_cv);
+}
 
-		pgds_rel_index = 0;
-		pgds_table_index = 0;
-	}
-	else
+/*
+ * pgds_inflight_busy
+ */
+static bool
+pgds_inflight_busy(Oid relid)
+{
+	int i;
+	bool busy = false;
+
+	LWLockAcquire(pgds->lock, LW_SHARED);
+	for (i = 0; i < MAX_INFLIGHT; i++)
 	{
-		elog(LOG, "pgds: pgds_analyze: return");
+		pgdsInflight *slot = &pgds->inflight[i];
+
+		if (slot->pid != 0 && slot->pid != MyProcPid &&
+		    slot->dboid == MyDatabaseId && slot->relid == relid)
+		{
+			busy = true;
+			break;
+		}
 	}
+	LWLockRelease(pgds->lock);
 
-	if (prev_post_parse_analyze_hook)
+	return busy;
+}
+
+/*
+ * pgds_inflight_wait
+ *
+ * wait for end of transaction analyzing relid in another backend: returns
+ * false on timeout. A backend having claimed relations does not wait
+ * to avoid waiting cycles.
+ */
+static bool
+pgds_inflight_wait(Oid relid)
+{
+	instr_time	start;
+	instr_time	now;
+	long		elapsed;
+
+	if (pgds_analyze_wait_timeout == 0 || pgds_inflight_nclaimed > 0)
+		return false;
+
+	INSTR_TIME_SET_CURRENT(start);
+	ConditionVariablePrepareToSleep(&pgds->inflight_cv);
+	while (pgds_inflight_busy(relid))
 	{
-#if PG_VERSION_NUM < 140000
-		prev_post_parse_analyze_hook(pstate, query);
+		INSTR_TIME_SET_CURRENT(now);
+		INSTR_TIME_SUBTRACT(now, start);
+		elapsed = (long) INSTR_TIME_GET_MILLISEC(now);
+		if (elapsed >= pgds_analyze_wait_timeout)
+		{
+			ConditionVariableCancelSleep();
+			return false;
+		}
+#if PG_VERSION_NUM >= 130000
+		(void) ConditionVariableTimedSleep(&pgds->inflight_cv,
+						   pgds_analyze_wait_timeout - elapsed,
+						   pgds_we_analyze_wait);
 #else
-		prev_post_parse_analyze_hook(pstate, query, js);
+		/* no timed sleep: broadcast sets latch of processes prepared to sleep */
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+				 pgds_analyze_wait_timeout - elapsed, pgds_we_analyze_wait);
+		ResetLatch(MyLatch);
+		CHECK_FOR_INTERRUPTS();
+		ConditionVariablePrepareToSleep(&pgds->inflight_cv);
 #endif
-	 }
+	}
+	ConditionVariableCancelSleep();
 
-	elog(LOG, "pgds: pgds_analyze: exit");
+	return true;
 }
 
-
 /*
+ * pgds_governor_admit
  *
- * pgds_analyze_table
- * 
+ * count this process in running analyses if fewer than
+ * pgds.max_concurrent_analyses are running and the sampled pages token
+ * bucket is not in debt: returns false otherwise
  */
-static void pgds_analyze_table(int index)
+static bool
+pgds_governor_admit(void)
 {
-	
-	StringInfoData buf_select;
-	StringInfoData buf_analyze;
-	SPITupleTable *tuptable;
-    TupleDesc tupdesc;
-    char *count_val;
-	int ret;
+	TimestampTz	now;
+	bool		admitted = true;
 
-	if (!superuser() && GetUserId() != pgds_tableowner_array[index])
+	if (pgds == NULL || pgds_governor_held)
+		return true;
+
+	now = GetCurrentTimestamp();
+	SpinLockAcquire(&pgds->governor_mutex);
+	if (pgds_io_pages_per_second > 0)
 	{
-		elog (INFO, "pgds_analyze_table: current user cannot analyze %s", pgds_tablename_array[index]);
-		return;
+		/* bucket holds at most one second of reads */
+		if (pgds->io_refill != 0)
+			pgds->io_tokens += pgds_io_pages_per_second *
+				((now - pgds->io_refill) / 1000000.0);
+		else
+			pgds->io_tokens = pgds_io_pages_per_second;
+		pgds->io_tokens = Min(pgds->io_tokens, (double) pgds_io_pages_per_second);
+		pgds->io_refill = now;
+		if (pgds->io_tokens < 0)
+			admitted = false;
 	}
+	if (pgds_max_concurrent_analyses > 0 && pgds->running >= pgds_max_concurrent_analyses)
+		admitted = false;
+	if (admitted)
+		pgds->running++;
+	SpinLockRelease(&pgds->governor_mutex);
 
-    initStringInfo(&buf_select);
-    appendStringInfo(&buf_select,
-                     " select count(*) from pg_statistic where starelid = '%d'", pgds_tableoid_array[index]);
-    ret = SPI_execute(buf_select.data, false, 0);
-    if (ret != SPI_OK_SELECT)
-         elog(FATAL, "cannot select from pg_statistic for rel_id: %d  error code: %d", pgds_tableoid_array[index], ret);
-    /* 
-    ** count(*) returns only 1 row with 1 column
-    */
-    tuptable = SPI_tuptable;
-    tupdesc = tuptable->tupdesc;
-    count_val = SPI_getvalue(tuptable->vals[0], tupdesc, 1);
-	elog(DEBUG1,"pgds: pgds_analyze_table: oid: %d  tablename: %s count_val: %s", 
-	             pgds_tableoid_array[index], pgds_tablename_array[index], count_val);
+	pgds_governor_held = admitted;
+	if (admitted)
+		pgds_governor_subid = GetCurrentSubTransactionId();
 
-    if (strcmp(count_val, "0") == 0) 
-	{
-		initStringInfo(&buf_analyze);
-		appendStringInfo(&buf_analyze, "analyze verbose %s;", pgds_tablename_array[index]);
-		elog(DEBUG1,"pgds: pgds_analyze_table: analyze: %s", pgds_tablename_array[index]);
-		ret = SPI_execute(buf_analyze.data, false, 0);
-		if (ret != SPI_OK_UTILITY)
-			elog(FATAL, "cannot run analyze for %s: error code %d", pgds_tablename_array[index], ret);
-	}
+	return admitted;
+}
+
+/*
+ * pgds_governor_charge
+ *
+ * take pages sampled by ANALYZE of relid from the token bucket: ANALYZE
+ * reads at most one page per sampled row
+ */
+static void
+pgds_governor_charge(Oid relid)
+{
+	Relation	rel;
+	double		pages;
+
+	if (pgds == NULL || pgds_io_pages_per_second == 0)
+		return;
+
+	rel = try_relation_open(relid, AccessShareLock);
+	if (rel == NULL)
+		return;
+	if (rel->rd_rel->relkind == RELKIND_FOREIGN_TABLE)
+		pages = 0;
+	else if (rel->rd_rel->relkind == RELKIND_PARTITIONED_TABLE)
+		pages = 300.0 * default_statistics_target;
+	else
+		pages = Min((double) RelationGetNumberOfBlocks(rel), 300.0 * default_statistics_target);
+	relation_close(rel, AccessShareLock);
+
+	SpinLockAcquire(&pgds->governor_mutex);
+	pgds->io_tokens -= pages;
+	SpinLockRelease(&pgds->governor_mutex);
 }
 
+/*
+ * pgds_governor_release
+ *
+ * remove this process from running analyses
+ */
+static void
+pgds_governor_release(void)
+{
+	if (!pgds_governor_held)
+		return;
 
+	SpinLockAcquire(&pgds->governor_mutex);
+	pgds->running--;
+	SpinLockRelease(&pgds->governor_mutex);
+	pgds_governor_held = false;
+}
 
+/*
+ * pgds_governor_sample
+ *
+ * sample load in a pgds worker, outside any transaction, into shared
+ * memory: more than pgds.defer_active_backends active client backends, a
+ * checkpoint running or a standby (or this standby) replaying more than
+ * pgds.defer_replication_lag late. Activity of other users is only visible
+ * to members of pg_read_all_stats.
+ */
+static void
+pgds_governor_sample(void)
+{
+	StringInfoData	buf;
+	uint32		flags = 0;
+	int		ret;
+	bool		isnull;
+
+	initStringInfo(&buf);
+	appendStringInfo(&buf, "select %s, %s, %s",
+			 pgds_defer_active_backends > 0 ?
+			 psprintf("(select count(*) from pg_stat_activity"
+				  " where state = 'active' and backend_type = 'client backend') > %d",
+				  pgds_defer_active_backends) : "false",
+			 /* checkpointer waits on CheckpointerMain between checkpoints, on nothing while writing */
+			 pgds_defer_during_checkpoint ?
+			 "exists (select 1 from pg_stat_activity where backend_type = 'checkpointer'"
+			 " and wait_event is distinct from 'CheckpointerMain')" : "false",
+			 pgds_defer_replication_lag > 0 ?
+			 psprintf("exists (select 1 from pg_stat_replication where replay_lag > interval '%d ms')"
+				  " or (pg_is_in_recovery() and pg_last_wal_receive_lsn() is distinct from pg_last_wal_replay_lsn()"
+				  " and now() - pg_last_xact_replay_timestamp() > interval '%d ms')",
+				  pgds_defer_replication_lag, pgds_defer_replication_lag) : "false");
+
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	SPI_connect();
+	PushActiveSnapshot(GetTransactionSnapshot());
+	ret = SPI_execute(buf.data, true, 1);
+	if (ret != SPI_OK_SELECT || SPI_processed != 1)
+		elog(ERROR, "pgds: cannot select from pg_stat_activity: error code %d", ret);
+	if (DatumGetBool(SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &isnull)))
+		flags |= PGDS_LOAD_BACKENDS;
+	if (DatumGetBool(SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 2, &isnull)))
+		flags |= PGDS_LOAD_CHECKPOINT;
+	if (DatumGetBool(SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 3, &isnull)))
+		flags |= PGDS_LOAD_LAG;
+	SPI_finish();
+	PopActiveSnapshot();
+	CommitTransactionCommand();
+	pfree(buf.data);
+
+	/* checkpointer wakes up briefly between checkpoints: a checkpoint is seen twice in a row */
+	if ((flags & PGDS_LOAD_CHECKPOINT) && (pg_atomic_read_u32(&pgds->load_flags) & PGDS_LOAD_CHECKPOINT))
+		flags |= PGDS_LOAD_CHECKPOINT_PREV;
+	pg_atomic_write_u32(&pgds->load_flags, flags);
+	pg_atomic_write_u64(&pgds->load_sampled, (uint64) GetCurrentTimestamp());
+}
+
+/*
+ * pgds_governor_load_known
+ *
+ * false if a load threshold is set and last load sample of pgds workers is
+ * older than PGDS_LOAD_MAX_AGE
+ */
+static bool
+pgds_governor_load_known(void)
+{
+	TimestampTz	sampled;
+
+	if (pgds == NULL ||
+	    (pgds_defer_active_backends == 0 && !pgds_defer_during_checkpoint &&
+	     pgds_defer_replication_lag == 0))
+		return true;
+
+	sampled = (TimestampTz) pg_atomic_read_u64(&pgds->load_sampled);
+	return (sampled != 0 &&
+		!TimestampDifferenceExceeds(sampled, GetCurrentTimestamp(), PGDS_LOAD_MAX_AGE));
+}
+
+/*
+ * pgds_governor_overloaded
+ *
+ * returns true if last load sample of pgds workers is above thresholds or
+ * load is unknown: analysis is then left to a worker, which samples it. No
+ * lock is taken.
+ */
+static bool
+pgds_governor_overloaded(void)
+{
+	uint32		flags;
+
+	if (pgds == NULL ||
+	    (pgds_defer_active_backends == 0 && !pgds_defer_during_checkpoint &&
+	     pgds_defer_replication_lag == 0))
+		return false;
+	if (!pgds_governor_load_known())
+		return true;
+
+	flags = pg_atomic_read_u32(&pgds->load_flags);
+	return ((pgds_defer_active_backends > 0 && (flags & PGDS_LOAD_BACKENDS)) ||
+		(pgds_defer_during_checkpoint && (flags & PGDS_LOAD_CHECKPOINT) &&
+		 (flags & PGDS_LOAD_CHECKPOINT_PREV)) ||
+		(pgds_defer_replication_lag > 0 && (flags & PGDS_LOAD_LAG)));
+}
+
+/*
+ * pgds_governor_wait
+ *
+ * admission of analysis of relid by a worker, or by a backend (in_xact):
+ * wait until load is below thresholds and governor admits it. A worker
+ * samples load at each try and waits as long as needed, a backend waits at
+ * most PGDS_GOVERNOR_MAX_WAIT, and not at all when load is unknown. Returns
+ * false if backend was not admitted.
+ */
+static bool
+pgds_governor_wait(Oid relid, bool in_xact)
+{
+	instr_time	start;
+	instr_time	duration;
+	bool		waited = false;
+	bool		admitted = true;
+
+	INSTR_TIME_SET_CURRENT(start);
+	pgds_init_wait_events();
+	for (;;)
+	{
+		if (!in_xact && (pgds_defer_active_backends > 0 || pgds_defer_during_checkpoint ||
+				 pgds_defer_replication_lag > 0))
+			pgds_governor_sample();
+
+		if (!pgds_governor_overloaded() && pgds_governor_admit())
+			break;
+
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, start);
+		if (in_xact && (INSTR_TIME_GET_MILLISEC(duration) >= PGDS_GOVERNOR_MAX_WAIT ||
+				!pgds_governor_load_known()))
+		{
+			admitted = false;
+			break;
+		}
+
+		waited = true;
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+				 PGDS_GOVERNOR_NAPTIME, pgds_we_governor_wait);
+		ResetLatch(MyLatch);
+		CHECK_FOR_INTERRUPTS();
+#if PG_VERSION_NUM >= 130000
+		if (!in_xact && ConfigReloadPending)
+		{
+			ConfigReloadPending = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+#endif
+	}
+
+	if (waited)
+	{
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, start);
+		pgds_count(PGDS_STAT_GOVERNOR_DEFERRED, 1);
+		pgds_event(PGDS_EVENT_GOVERNOR_WAIT, relid, INSTR_TIME_GET_MICROSEC(duration), true);
+	}
+
+	return admitted;
+}
+
+/*
+ * pgds_subxact_callback
+ *
+ * an analysis aborted in a subtransaction leaves running analyses
+ */
+static void
+pgds_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+		      SubTransactionId parentSubid, void *arg)
+{
+	if (event == SUBXACT_EVENT_ABORT_SUB && pgds_governor_held && pgds_governor_subid >= mySubid)
+		pgds_governor_release();
+}
+
+/*
+ * pgds_xact_callback
+ *
+ * release relations claimed by this backend at transaction end
+ */
+static void
+pgds_xact_callback(XactEvent event, void *arg)
+{
+	int i;
+
+	switch (event)
+	{
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PARALLEL_COMMIT:
+		case XACT_EVENT_PARALLEL_ABORT:
+		case XACT_EVENT_PREPARE:
+			break;
+		default:
+			return;
+	}
+
+	/*
+	 * an error raised while pgds_analyze was running must not leave
+	 * pgds disabled for the rest of the session
+	 */
+	if (!pgds_is_worker)
+	{
+		pgds_avoid_recursion = 0;
+		pgds_rel_index = 0;
+		pgds_func_index = 0;
+		pgds_table_index = 0;
+	}
+
+	pgds_governor_release();
+
+	if (pgds_inflight_nclaimed == 0)
+		return;
+
+	LWLockAcquire(pgds->lock, LW_EXCLUSIVE);
+	for (i = 0; i < pgds_inflight_nclaimed; i++)
+		memset(&pgds->inflight[pgds_inflight_claimed[i]], 0, sizeof(pgdsInflight));
+	LWLockRelease(pgds->lock);
+	pgds_inflight_nclaimed = 0;
+
+	ConditionVariableBroadcast(&pgds->inflight_cv);
+}
+
+/*
+ * pgds_breaker_open
+ *
+ * returns true if pgds (relid is InvalidOid) or relid processing is
+ * disabled by circuit breaker
+ */
+static bool
+pgds_breaker_open(Oid relid)
+{
+	TimestampTz	now;
+	bool		open = false;
+	int		i;
+
+	if (pgds == NULL || pgds_breaker_threshold == 0)
+		return false;
+
+	if (!OidIsValid(relid))
+	{
+		TimestampTz open_until = (TimestampTz) pg_atomic_read_u64(&pgds->breaker_open_until);
+
+		return (open_until != 0 && GetCurrentTimestamp() < open_until);
+	}
+
+	if (pg_atomic_read_u32(&pgds->breaker_nrels) == 0)
+		return false;
+
+	now = GetCurrentTimestamp();
+	LWLockAcquire(pgds->lock, LW_SHARED);
+	for (i = 0; i < PGDS_BREAKER_RELS; i++)
+	{
+		pgdsBreakerRel *rel = &pgds->breaker_rels[i];
+
+		if (rel->relid == relid && rel->dboid == MyDatabaseId)
+		{
+			open = (now < rel->open_until);
+			break;
+		}
+	}
+	LWLockRelease(pgds->lock);
+
+	return open;
+}
+
+/*
+ * pgds_breaker_failure
+ *
+ * account failure of pgds processing of relid (InvalidOid if unknown)
+ */
+static void
+pgds_breaker_failure(Oid relid)
+{
+	TimestampTz	now = GetCurrentTimestamp();
+	TimestampTz	open_until = TimestampTzPlusMilliseconds(now, pgds_breaker_cooldown * 1000L);
+	int		i;
+	int		nrels = 0;
+	pgdsBreakerRel	*entry = NULL;
+
+	if (pgds == NULL || pgds_breaker_threshold == 0)
+		return;
+
+	if (pg_atomic_add_fetch_u32(&pgds->breaker_failures, 1) >= pgds_breaker_threshold)
+	{
+		pg_atomic_write_u32(&pgds->breaker_failures, 0);
+		pg_atomic_write_u64(&pgds->breaker_open_until, (uint64) open_until);
+		elog(LOG, "pgds: disabled for %d s after %d consecutive failures",
+		     pgds_breaker_cooldown, pgds_breaker_threshold);
+	}
+
+	if (!OidIsValid(relid))
+		return;
+
+	LWLockAcquire(pgds->lock, LW_EXCLUSIVE);
+	for (i = 0; i < PGDS_BREAKER_RELS; i++)
+	{
+		pgdsBreakerRel *rel = &pgds->breaker_rels[i];
+
+		if (rel->relid == relid && rel->dboid == MyDatabaseId)
+		{
+			entry = rel;
+			break;
+		}
+	}
+	if (entry == NULL)
+	{
+		/* reuse free or expired entry, else entry with fewest failures */
+		for (i = 0; i < PGDS_BREAKER_RELS; i++)
+		{
+			pgdsBreakerRel *rel = &pgds->breaker_rels[i];
+
+			if (rel->relid == InvalidOid || (rel->failures == 0 && rel->open_until <= now))
+			{
+				entry = rel;
+				break;
+			}
+			if (entry == NULL || rel->failures < entry->failures)
+				entry = rel;
+		}
+		entry->dboid = MyDatabaseId;
+		entry->relid = relid;
+		entry->failures = 0;
+		entry->open_until = 0;
+	}
+	if (++entry->failures >= pgds_breaker_threshold)
+	{
+		entry->failures = 0;
+		entry->open_until = open_until;
+		elog(LOG, "pgds: relation %u skipped for %d s after %d failures",
+		     relid, pgds_breaker_cooldown, pgds_breaker_threshold);
+	}
+	for (i = 0; i < PGDS_BREAKER_RELS; i++)
+		if (pgds->breaker_rels[i].relid != InvalidOid)
+			nrels++;
+	pg_atomic_write_u32(&pgds->breaker_nrels, nrels);
+	LWLockRelease(pgds->lock);
+}
+
+/*
+ * pgds_breaker_success
+ */
+static void
+pgds_breaker_success(void)
+{
+	if (pgds != NULL && pg_atomic_read_u32(&pgds->breaker_failures) != 0)
+		pg_atomic_write_u32(&pgds->breaker_failures, 0);
+}
+
+/*
+ * pgds_demand_record
+ *
+ * record in standby demand ring that relid has no statistics: the primary
+ * analyzes it as relowner
+ */
+static void
+pgds_demand_record(Oid relid, Oid relowner)
+{
+	pgdsDemand	*entry = NULL;
+	int		i;
+
+	if (pgds == NULL)
+		return;
+
+	LWLockAcquire(pgds->lock, LW_EXCLUSIVE);
+	for (i = 0; i < PGDS_DEMAND_RING; i++)
+	{
+		if (pgds->demand[i].relid == relid && pgds->demand[i].dboid == MyDatabaseId)
+		{
+			entry = &pgds->demand[i];
+			break;
+		}
+	}
+	if (entry == NULL)
+	{
+		entry = &pgds->demand[pgds->demand_next];
+		pgds->demand_next = (pgds->demand_next + 1) % PGDS_DEMAND_RING;
+		entry->dboid = MyDatabaseId;
+		entry->relid = relid;
+		entry->demands = 0;
+	}
+	entry->relowner = relowner;
+	entry->demands++;
+	entry->last_demand = GetCurrentTimestamp();
+	LWLockRelease(pgds->lock);
+}
+
+/*
+ * pgds_funcrows_args_hash
+ *
+ * hash of constant arguments of a function call: 0 if an argument is not
+ * a constant
+ */
+static uint32 pgds_funcrows_args_hash(List *args)
+{
+	uint32 h = 1;
+	ListCell *lc;
+
+	foreach(lc, args)
+	{
+		Const *c = (Const *) lfirst(lc);
+
+		if (!IsA(c, Const))
+			return 0;
+		h = hash_combine(h, c->consttype);
+		if (c->constisnull)
+			h = hash_combine(h, 0);
+		else
+			h = hash_combine(h, datum_image_hash(c->constvalue, c->constbyval, c->constlen));
+	}
+
+	return (h == 0) ? 1 : h;
+}
+
+/*
+ * pgds_funcrows_enter
+ *
+ * find or create entry of key, evicting least recently called entry when
+ * hash is full: caller holds funcrows_lock exclusively
+ */
+static pgdsFuncRowsEntry *pgds_funcrows_enter(pgdsFuncRowsKey *key)
+{
+	pgdsFuncRowsEntry *entry;
+	bool	found;
+
+	entry = (pgdsFuncRowsEntry *) hash_search(pgds_funcrows_hash, key, HASH_FIND, NULL);
+	if (entry != NULL)
+		return entry;
+
+	if (hash_get_num_entries(pgds_funcrows_hash) >= PGDS_FUNC_ROWS)
+	{
+		HASH_SEQ_STATUS	hash_seq;
+		pgdsFuncRowsEntry *oldest = NULL;
+
+		hash_seq_init(&hash_seq, pgds_funcrows_hash);
+		while ((entry = hash_seq_search(&hash_seq)) != NULL)
+			if (oldest == NULL || entry->last_call < oldest->last_call)
+				oldest = entry;
+		if (oldest != NULL)
+			(void) hash_search(pgds_funcrows_hash, &oldest->key, HASH_REMOVE, NULL);
+	}
+
+	entry = (pgdsFuncRowsEntry *) hash_search(pgds_funcrows_hash, key, HASH_ENTER_NULL, &found);
+	if (entry != NULL && !found)
+	{
+		SpinLockInit(&entry->mutex);
+		entry->rows = 0;
+		entry->calls = 0;
+		entry->last_call = 0;
+	}
+
+	return entry;
+}
+
+/*
+ * pgds_funcrows_record
+ *
+ * record rows returned by one call of func
+ */
+static void pgds_funcrows_record(FuncExpr *func, double rows)
+{
+	pgdsFuncRowsKey key;
+	pgdsFuncRowsEntry *entry;
+	uint32	argshash = pgds_funcrows_args_hash(func->args);
+	TimestampTz now = GetCurrentTimestamp();
+	int	i;
+
+	memset(&key, 0, sizeof(key));
+	key.dboid = MyDatabaseId;
+	key.funcid = func->funcid;
+
+	for (i = 0; i < 2; i++)
+	{
+		key.argshash = (i == 0) ? 0 : argshash;
+		if (i == 1 && argshash == 0)
+			break;
+
+		LWLockAcquire(pgds->funcrows_lock, LW_SHARED);
+		entry = (pgdsFuncRowsEntry *) hash_search(pgds_funcrows_hash, &key, HASH_FIND, NULL);
+		if (entry == NULL)
+		{
+			LWLockRelease(pgds->funcrows_lock);
+			LWLockAcquire(pgds->funcrows_lock, LW_EXCLUSIVE);
+			entry = pgds_funcrows_enter(&key);
+		}
+		if (entry != NULL)
+		{
+			SpinLockAcquire(&entry->mutex);
+			entry->rows += (rows - entry->rows) / Min(entry->calls + 1, PGDS_FUNC_ROWS_WINDOW);
+			entry->calls++;
+			entry->last_call = now;
+			SpinLockRelease(&entry->mutex);
+		}
+		LWLockRelease(pgds->funcrows_lock);
+	}
+}
+
+/*
+ * pgds_funcrows_lookup
+ *
+ * observed rows of func: calls with same constant arguments first, then
+ * all calls
+ */
+static bool pgds_funcrows_lookup(FuncExpr *func, double *rows)
+{
+	pgdsFuncRowsKey key;
+	pgdsFuncRowsEntry *entry = NULL;
+
+	memset(&key, 0, sizeof(key));
+	key.dboid = MyDatabaseId;
+	key.funcid = func->funcid;
+	key.argshash = pgds_funcrows_args_hash(func->args);
+
+	LWLockAcquire(pgds->funcrows_lock, LW_SHARED);
+	if (key.argshash != 0)
+		entry = (pgdsFuncRowsEntry *) hash_search(pgds_funcrows_hash, &key, HASH_FIND, NULL);
+	if (entry == NULL)
+	{
+		key.argshash = 0;
+		entry = (pgdsFuncRowsEntry *) hash_search(pgds_funcrows_hash, &key, HASH_FIND, NULL);
+	}
+	if (entry != NULL)
+	{
+		SpinLockAcquire(&entry->mutex);
+		*rows = entry->rows;
+		SpinLockRelease(&entry->mutex);
+	}
+	LWLockRelease(pgds->funcrows_lock);
+
+	return (entry != NULL);
+}
+
+/*
+ * pgds_qual_hash_walker
+ *
+ * hash expression tree ignoring range table indexes and locations so that
+ * clauses hash the same in planner and in executor
+ */
+static bool pgds_qual_hash_walker(Node *node, void *context)
+{
+	uint32 *h = (uint32 *) context;
+
+	if (node == NULL)
+		return false;
+
+	*h = hash_combine(*h, (uint32) nodeTag(node));
+	switch (nodeTag(node))
+	{
+		case T_Var:
+			*h = hash_combine(*h, (uint32) ((Var *) node)->varattno);
+			*h = hash_combine(*h, ((Var *) node)->varlevelsup);
+			return false;
+		case T_Const:
+			{
+				Const *c = (Const *) node;
+
+				*h = hash_combine(*h, c->consttype);
+				if (!c->constisnull)
+					*h = hash_combine(*h, datum_image_hash(c->constvalue, c->constbyval, c->constlen));
+				return false;
+			}
+		case T_Param:
+			*h = hash_combine(*h, (uint32) ((Param *) node)->paramkind);
+			*h = hash_combine(*h, (uint32) ((Param *) node)->paramid);
+			return false;
+		case T_OpExpr:
+		case T_DistinctExpr:
+		case T_NullIfExpr:
+			*h = hash_combine(*h, ((OpExpr *) node)->opno);
+			break;
+		case T_ScalarArrayOpExpr:
+			*h = hash_combine(*h, ((ScalarArrayOpExpr *) node)->opno);
+			*h = hash_combine(*h, ((ScalarArrayOpExpr *) node)->useOr);
+			break;
+		case T_FuncExpr:
+			*h = hash_combine(*h, ((FuncExpr *) node)->funcid);
+			break;
+		case T_BoolExpr:
+			*h = hash_combine(*h, (uint32) ((BoolExpr *) node)->boolop);
+			break;
+		case T_NullTest:
+			*h = hash_combine(*h, (uint32) ((NullTest *) node)->nulltesttype);
+			break;
+		case T_BooleanTest:
+			*h = hash_combine(*h, (uint32) ((BooleanTest *) node)->booltesttype);
+			break;
+		default:
+			break;
+	}
+
+	return expression_tree_walker(node, pgds_qual_hash_walker, context);
+}
+
+/*
+ * pgds_qual_hash
+ *
+ * hash of clauses (or RestrictInfos) of both lists that does not depend on
+ * their order or on the list they are in: 0 if there is no clause.
+ * Pseudo constant RestrictInfos are not scan clauses and are skipped.
+ */
+static uint32 pgds_qual_hash(List *clauses1, List *clauses2)
+{
+	uint32 h = 0;
+	bool empty = true;
+	ListCell *lc;
+	int i;
+
+	for (i = 0; i < 2; i++)
+	{
+		foreach(lc, (i == 0) ? clauses1 : clauses2)
+		{
+			Node *clause = (Node *) lfirst(lc);
+			uint32 ch = 1;
+
+			if (IsA(clause, RestrictInfo))
+			{
+				if (((RestrictInfo *) clause)->pseudoconstant)
+					continue;
+				clause = (Node *) ((RestrictInfo *) clause)->clause;
+			}
+			(void) pgds_qual_hash_walker(clause, &ch);
+			h += ch;
+			empty = false;
+		}
+	}
+
+	return (!empty && h == 0) ? 1 : h;
+}
+
+/*
+ * pgds_foreignrows_enter
+ *
+ * find or create entry of key, evicting least recently scanned entry when
+ * hash is full: caller holds foreignrows_lock exclusively
+ */
+static pgdsForeignRowsEntry *pgds_foreignrows_enter(pgdsForeignRowsKey *key)
+{
+	pgdsForeignRowsEntry *entry;
+	bool	found;
+
+	entry = (pgdsForeignRowsEntry *) hash_search(pgds_foreignrows_hash, key, HASH_FIND, NULL);
+	if (entry != NULL)
+		return entry;
+
+	if (hash_get_num_entries(pgds_foreignrows_hash) >= PGDS_FOREIGN_ROWS)
+	{
+		HASH_SEQ_STATUS	hash_seq;
+		pgdsForeignRowsEntry *oldest = NULL;
+
+		hash_seq_init(&hash_seq, pgds_foreignrows_hash);
+		while ((entry = hash_seq_search(&hash_seq)) != NULL)
+			if (oldest == NULL || entry->last_scan < oldest->last_scan)
+				oldest = entry;
+		if (oldest != NULL)
+			(void) hash_search(pgds_foreignrows_hash, &oldest->key, HASH_REMOVE, NULL);
+	}
+
+	entry = (pgdsForeignRowsEntry *) hash_search(pgds_foreignrows_hash, key, HASH_ENTER_NULL, &found);
+	if (entry != NULL && !found)
+	{
+		SpinLockInit(&entry->mutex);
+		entry->rows = 0;
+		entry->scans = 0;
+		entry->last_scan = 0;
+	}
+
+	return entry;
+}
+
+/*
+ * pgds_foreignrows_record
+ *
+ * record rows returned by one scan of foreign table relid with restriction
+ * clauses hashing to qualhash
+ */
+static void pgds_foreignrows_record(Oid relid, uint32 qualhash, double rows)
+{
+	pgdsForeignRowsKey key;
+	pgdsForeignRowsEntry *entry;
+
+	memset(&key, 0, sizeof(key));
+	key.dboid = MyDatabaseId;
+	key.relid = relid;
+	key.qualhash = qualhash;
+
+	LWLockAcquire(pgds->foreignrows_lock, LW_SHARED);
+	entry = (pgdsForeignRowsEntry *) hash_search(pgds_foreignrows_hash, &key, HASH_FIND, NULL);
+	if (entry == NULL)
+	{
+		LWLockRelease(pgds->foreignrows_lock);
+		LWLockAcquire(pgds->foreignrows_lock, LW_EXCLUSIVE);
+		entry = pgds_foreignrows_enter(&key);
+	}
+	if (entry != NULL)
+	{
+		SpinLockAcquire(&entry->mutex);
+		entry->rows += (rows - entry->rows) / Min(entry->scans + 1, PGDS_FUNC_ROWS_WINDOW);
+		entry->scans++;
+		entry->last_scan = GetCurrentTimestamp();
+		SpinLockRelease(&entry->mutex);
+	}
+	LWLockRelease(pgds->foreignrows_lock);
+}
+
+/*
+ * pgds_foreignrows_lookup
+ */
+static bool pgds_foreignrows_lookup(Oid relid, uint32 qualhash, double *rows)
+{
+	pgdsForeignRowsKey key;
+	pgdsForeignRowsEntry *entry;
+
+	memset(&key, 0, sizeof(key));
+	key.dboid = MyDatabaseId;
+	key.relid = relid;
+	key.qualhash = qualhash;
+
+	LWLockAcquire(pgds->foreignrows_lock, LW_SHARED);
+	entry = (pgdsForeignRowsEntry *) hash_search(pgds_foreignrows_hash, &key, HASH_FIND, NULL);
+	if (entry != NULL)
+	{
+		SpinLockAcquire(&entry->mutex);
+		*rows = entry->rows;
+		SpinLockRelease(&entry->mutex);
+	}
+	LWLockRelease(pgds->foreignrows_lock);
+
+	return (entry != NULL);
+}
+
+/*
+ * pgds_funcrows_scan
+ *
+ * set returning function of a scan of this function alone, or NULL
+ */
+static FuncExpr *pgds_funcrows_scan(PlanState *ps)
+{
+	RangeTblFunction *rtfunc;
+
+	if (!IsA(ps, FunctionScanState) || list_length(((FunctionScan *) ps->plan)->functions) != 1)
+		return NULL;
+	rtfunc = linitial_node(RangeTblFunction, ((FunctionScan *) ps->plan)->functions);
+	if (!IsA(rtfunc->funcexpr, FuncExpr) || !((FuncExpr *) rtfunc->funcexpr)->funcretset)
+		return NULL;
+
+	return (FuncExpr *) rtfunc->funcexpr;
+}
+
+/*
+ * pgds_funcrows_instrument
+ *
+ * count rows of function and foreign table scans not already instrumented
+ */
+static bool pgds_funcrows_instrument(PlanState *ps, void *context)
+{
+	if (ps == NULL)
+		return false;
+
+	if (ps->instrument == NULL &&
+	    ((pgds_function_rows && pgds_funcrows_scan(ps) != NULL) ||
+	     (pgds_foreign_rows && IsA(ps, ForeignScanState) &&
+	      ((ForeignScan *) ps->plan)->scan.scanrelid > 0)))
+	{
+#if PG_VERSION_NUM >= 140000
+		ps->instrument = InstrAlloc(1, INSTRUMENT_ROWS, false);
+#else
+		ps->instrument = InstrAlloc(1, INSTRUMENT_ROWS);
+#endif
+	}
+
+	return planstate_tree_walker(ps, pgds_funcrows_instrument, context);
+}
+
+/*
+ * pgds_funcrows_collect
+ *
+ * record rows returned by function scans and foreign table scans, counted
+ * by their instrumentation: scans below a Limit node or a semi or anti join
+ * may not have read all rows and are ignored. context counts such nodes
+ * above current node.
+ */
+static bool pgds_funcrows_collect(PlanState *ps, void *context)
+{
+	int *limited = (int *) context;
+	FuncExpr *funcexpr;
+
+	if (ps == NULL)
+		return false;
+
+	if (IsA(ps, LimitState) ||
+	    ((IsA(ps, NestLoopState) || IsA(ps, MergeJoinState) || IsA(ps, HashJoinState)) &&
+	     (((Join *) ps->plan)->jointype == JOIN_SEMI || ((Join *) ps->plan)->jointype == JOIN_ANTI
+#if PG_VERSION_NUM >= 160000
+	      || ((Join *) ps->plan)->jointype == JOIN_RIGHT_ANTI
+#endif
+#if PG_VERSION_NUM >= 180000
+	      || ((Join *) ps->plan)->jointype == JOIN_RIGHT_SEMI
+#endif
+	      )))
+	{
+		(*limited)++;
+		(void) planstate_tree_walker(ps, pgds_funcrows_collect, context);
+		(*limited)--;
+		return false;
+	}
+
+	/* rows removed by scan filter were returned by function */
+	funcexpr = pgds_function_rows ? pgds_funcrows_scan(ps) : NULL;
+	if (funcexpr != NULL && ps->instrument != NULL && *limited == 0)
+	{
+		InstrEndLoop(ps->instrument);
+		if (ps->instrument->nloops > 0)
+			pgds_funcrows_record(funcexpr,
+					     (ps->instrument->ntuples + ps->instrument->nfiltered1) /
+					     ps->instrument->nloops);
+	}
+
+	/* rows of parameterized scans do not match restriction clauses of a base scan */
+	if (pgds_foreign_rows && IsA(ps, ForeignScanState) && ps->instrument != NULL && *limited == 0 &&
+	    ((ForeignScan *) ps->plan)->scan.scanrelid > 0 && bms_is_empty(ps->plan->extParam))
+	{
+		ForeignScan *fs = (ForeignScan *) ps->plan;
+
+		InstrEndLoop(ps->instrument);
+		if (ps->instrument->nloops > 0)
+			pgds_foreignrows_record(exec_rt_fetch(fs->scan.scanrelid, ps->state)->relid,
+						pgds_qual_hash(fs->scan.plan.qual, fs->fdw_recheck_quals),
+						ps->instrument->ntuples / ps->instrument->nloops);
+	}
+
+	return planstate_tree_walker(ps, pgds_funcrows_collect, context);
+}
+
+/*
+ * pgds_ExecutorStart
+ */
+static void pgds_ExecutorStart(QueryDesc *queryDesc, int eflags)
+{
+	if (prev_ExecutorStart)
+		prev_ExecutorStart(queryDesc, eflags);
+	else
+		standard_ExecutorStart(queryDesc, eflags);
+
+	if ((pgds_function_rows || pgds_foreign_rows) && pgds_mode != PGDS_MODE_OFF && pgds != NULL &&
+	    (eflags & EXEC_FLAG_EXPLAIN_ONLY) == 0 && queryDesc->planstate != NULL)
+	{
+		MemoryContext oldcxt = MemoryContextSwitchTo(queryDesc->estate->es_query_cxt);
+
+		(void) pgds_funcrows_instrument(queryDesc->planstate, NULL);
+		MemoryContextSwitchTo(oldcxt);
+	}
+}
+
+/*
+ * pgds_ExecutorEnd
+ */
+static void pgds_ExecutorEnd(QueryDesc *queryDesc)
+{
+	if ((pgds_function_rows || pgds_foreign_rows) && pgds_mode != PGDS_MODE_OFF && pgds != NULL &&
+	    queryDesc->planstate != NULL)
+	{
+		int limited = 0;
+
+		(void) pgds_funcrows_collect(queryDesc->planstate, &limited);
+	}
+
+	if (prev_ExecutorEnd)
+		prev_ExecutorEnd(queryDesc);
+	else
+		standard_ExecutorEnd(queryDesc);
+}
+
+/*
+ * pgds_foreign_pathlist
+ *
+ * replace rows estimate of a foreign table scan (local statistics or
+ * remote estimate) by rows observed by pgds_ExecutorEnd for same
+ * restriction clauses. Run cost of foreign scan paths is scaled to the
+ * observed rows, so that plans costed from local statistics (use_remote_estimate
+ * off) match plans costed from a remote estimate.
+ */
+static void pgds_foreign_pathlist(RelOptInfo *rel, RangeTblEntry *rte)
+{
+	double	rows;
+	double	run_cost;
+	ListCell *lc;
+
+	if (!pgds_foreignrows_lookup(rte->relid, pgds_qual_hash(rel->baserestrictinfo, NIL), &rows))
+		return;
+
+	rows = clamp_row_est(rows);
+	if (rows == rel->rows)
+		return;
+
+	elog(DEBUG1, "pgds: foreign table %u: %.0f rows instead of %.0f",
+	     rte->relid, rows, rel->rows);
+	pgds_count(PGDS_STAT_FOREIGN_ESTIMATES, 1);
+
+	rel->rows = rows;
+	foreach(lc, rel->pathlist)
+	{
+		Path *path = (Path *) lfirst(lc);
+
+		if (path->pathtype != T_ForeignScan || path->param_info != NULL)
+			continue;
+		if (path->rows > 0)
+		{
+			run_cost = path->total_cost - path->startup_cost;
+			path->total_cost = path->startup_cost + run_cost * rows / path->rows;
+		}
+		path->rows = rows;
+	}
+}
+
+/*
+ * pgds_set_rel_pathlist
+ *
+ * replace default rows estimate (prorows or support function) of a set
+ * returning function by rows observed by pgds_ExecutorEnd and recost
+ * function scan paths. Foreign table scans are handled by
+ * pgds_foreign_pathlist.
+ */
+static void pgds_set_rel_pathlist(PlannerInfo *root, RelOptInfo *rel, Index rti, RangeTblEntry *rte)
+{
+	RangeTblFunction *rtfunc;
+	double	rows;
+	double	ratio;
+	ListCell *lc;
+
+	if (prev_set_rel_pathlist_hook)
+		prev_set_rel_pathlist_hook(root, rel, rti, rte);
+
+	if (pgds_foreign_rows && pgds_mode != PGDS_MODE_OFF && pgds != NULL &&
+	    rte->rtekind == RTE_RELATION && rte->relkind == RELKIND_FOREIGN_TABLE &&
+	    rel->reloptkind == RELOPT_BASEREL)
+	{
+		pgds_foreign_pathlist(rel, rte);
+		return;
+	}
+
+	if (!pgds_function_rows || pgds_mode == PGDS_MODE_OFF || pgds == NULL ||
+	    rte->rtekind != RTE_FUNCTION || list_length(rte->functions) != 1 ||
+	    rel->reloptkind != RELOPT_BASEREL || rel->tuples <= 0)
+		return;
+
+	rtfunc = linitial_node(RangeTblFunction, rte->functions);
+	if (!IsA(rtfunc->funcexpr, FuncExpr) || !((FuncExpr *) rtfunc->funcexpr)->funcretset)
+		return;
+	if (!pgds_funcrows_lookup((FuncExpr *) rtfunc->funcexpr, &rows))
+		return;
+
+	rows = clamp_row_est(rows);
+	if (rows == rel->tuples)
+		return;
+
+	elog(DEBUG1, "pgds: function %u: %.0f rows instead of %.0f",
+	     ((FuncExpr *) rtfunc->funcexpr)->funcid, rows, rel->tuples);
+	pgds_count(PGDS_STAT_FUNCTION_ESTIMATES, 1);
+
+	/* keep selectivity of restriction clauses */
+	ratio = rows / rel->tuples;
+	rel->tuples = rows;
+	rel->rows = clamp_row_est(rel->rows * ratio);
+	foreach(lc, rel->ppilist)
+	{
+		ParamPathInfo *ppi = (ParamPathInfo *) lfirst(lc);
+
+		ppi->ppi_rows = clamp_row_est(ppi->ppi_rows * ratio);
+	}
+	foreach(lc, rel->pathlist)
+	{
+		Path *path = (Path *) lfirst(lc);
+
+		if (path->pathtype == T_FunctionScan)
+			cost_functionscan(path, root, rel, path->param_info);
+	}
+}
+
+/*
+ * Module load callback
+ */
+void
+_PG_init(void)
+{
+	elog(DEBUG5, "pgds:_PG_init():entry");
+
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+	elog(LOG, "pgds:_PG_init(): pgds is enabled ");
+
+#if PG_VERSION_NUM >= 180000
+	pgstat_register_kind(PGSTAT_KIND_PGDS, &pgds_relstat_kind);
+#else
+	DefineCustomIntVariable("pgds.max_relations",
+				"Maximum number of relations tracked in pg_stat_pgds_relations.",
+				NULL,
+				&pgds_max_relations,
+				5000,
+				100,
+				INT_MAX / 2,
+				PGC_POSTMASTER,
+				0,
+				NULL,
+				NULL,
+				NULL);
+#endif
+	DefineCustomEnumVariable("pgds.mode",
+				 "Sets how pgds gathers missing statistics.",
+				 "off disables pgds, sync runs ANALYZE before planning, async queues ANALYZE for a background worker.",
+				 &pgds_mode,
+				 PGDS_MODE_SYNC,
+				 pgds_mode_options,
+				 PGC_USERSET,
+				 0,
+				 NULL,
+				 NULL,
+				 NULL);
+	DefineCustomBoolVariable("pgds.function_rows",
+				 "Replaces rows estimate of set returning functions by observed rows.",
+				 NULL,
+				 &pgds_function_rows,
+				 true,
+				 PGC_USERSET,
+				 0,
+				 NULL,
+				 NULL,
+				 NULL);
+	DefineCustomIntVariable("pgds.quick_stats_min_pages",
+				"Minimum size in pages of a table without statistics for which quick statistics are built from its btree indexes.",
+				"Full ANALYZE of the table is then queued for pgds workers. 0 disables quick statistics.",
+				&pgds_quick_stats_min_pages,
+				1000,
+				0,
+				INT_MAX,
+				PGC_USERSET,
+				GUC_UNIT_BLOCKS,
+				NULL,
+				NULL,
+				NULL);
+	DefineCustomIntVariable("pgds.io_pages_per_second",
+				"Pages that ANALYZE run by pgds may sample per second in the whole cluster.",
+				"Analyses over this rate are queued for pgds workers, which wait. 0 disables the limit.",
+				&pgds_io_pages_per_second,
+				0,
+				0,
+				INT_MAX,
+				PGC_SIGHUP,
+				0,
+				NULL,
+				NULL,
+				NULL);
+	DefineCustomIntVariable("pgds.max_concurrent_analyses",
+				"Maximum number of ANALYZE run by pgds at the same time in the whole cluster.",
+				"Analyses over this number are queued for pgds workers, which wait. 0 disables the limit.",
+				&pgds_max_concurrent_analyses,
+				0,
+				0,
+				INT_MAX,
+				PGC_SIGHUP,
+				0,
+				NULL,
+				NULL,
+				NULL);
+	DefineCustomIntVariable("pgds.defer_active_backends",
+				"Number of active client backends above which pgds analyses are deferred.",
+				"0 disables this threshold.",
+				&pgds_defer_active_backends,
+				0,
+				0,
+				INT_MAX,
+				PGC_SIGHUP,
+				0,
+				NULL,
+				NULL,
+				NULL);
+	DefineCustomBoolVariable("pgds.defer_during_checkpoint",
+				 "Defers pgds analyses while a checkpoint is running.",
+				 NULL,
+				 &pgds_defer_during_checkpoint,
+				 false,
+				 PGC_SIGHUP,
+				 0,
+				 NULL,
+				 NULL,
+				 NULL);
+	DefineCustomIntVariable("pgds.defer_replication_lag",
+				"Replay lag of a standby above which pgds analyses are deferred.",
+				"0 disables this threshold.",
+				&pgds_defer_replication_lag,
+				0,
+				0,
+				INT_MAX,
+				PGC_SIGHUP,
+				GUC_UNIT_MS,
+				NULL,
+				NULL,
+				NULL);
+	DefineCustomBoolVariable("pgds.explain",
+				 "Adds pgds section to EXPLAIN output.",
+				 "Default of EXPLAIN option PGDS with PostgreSQL 18, text format only before PostgreSQL 18.",
+				 &pgds_explain,
+				 false,
+				 PGC_USERSET,
+				 0,
+				 NULL,
+				 NULL,
+				 NULL);
+	DefineCustomBoolVariable("pgds.foreign_rows",
+				 "Replaces rows estimate of foreign table scans by observed rows.",
+				 NULL,
+				 &pgds_foreign_rows,
+				 true,
+				 PGC_USERSET,
+				 0,
+				 NULL,
+				 NULL,
+				 NULL);
+	DefineCustomIntVariable("pgds.foreign_sample_rows",
+				"Number of rows sampled by ANALYZE of foreign tables without statistics.",
+				"Foreign tables are only analyzed by pgds workers. 0 disables foreign tables.",
+				&pgds_foreign_sample_rows,
+				3000,
+				0,
+				3000000,
+				PGC_SUSET,
+				0,
+				NULL,
+				NULL,
+				NULL);
+	DefineCustomRealVariable("pgds.event_sample_rate",
+				"Fraction of statements whose events are recorded in pgds event ring.",
+				"Analyses are always recorded.",
+				&pgds_event_sample_rate,
+				1.0,
+				0.0,
+				1.0,
+				PGC_SUSET,
+				0,
+				NULL,
+				NULL,
+				NULL);
+	DefineCustomIntVariable("pgds.analyze_wait_timeout",
+				"Maximum time to wait for another backend analyzing the same relation.",
+				"0 disables waiting.",
+				&pgds_analyze_wait_timeout,
+				10000,
+				0,
+				INT_MAX,
+				PGC_USERSET,
+				GUC_UNIT_MS,
+				NULL,
+				NULL,
+				NULL);
+	DefineCustomIntVariable("pgds.breaker_threshold",
+				"Number of consecutive failures that disables pgds or skips a relation.",
+				"0 disables the circuit breaker.",
+				&pgds_breaker_threshold,
+				5,
+				0,
+				INT_MAX,
+				PGC_SUSET,
+				0,
+				NULL,
+				NULL,
+				NULL);
+	DefineCustomIntVariable("pgds.breaker_cooldown",
+				"Time during which pgds or a relation stays disabled after repeated failures.",
+				NULL,
+				&pgds_breaker_cooldown,
+				60,
+				1,
+				INT_MAX / 1000,
+				PGC_SUSET,
+				GUC_UNIT_S,
+				NULL,
+				NULL,
+				NULL);
+	DefineCustomIntVariable("pgds.brin_summarize_ranges",
+				"Number of unsummarized ranges at the end of a table that triggers BRIN summarization.",
+				"0 disables BRIN summarization.",
+				&pgds_brin_summarize_ranges,
+				8,
+				0,
+				INT_MAX,
+				PGC_SUSET,
+				0,
+				NULL,
+				NULL,
+				NULL);
+	DefineCustomIntVariable("pgds.gin_pending_pages",
+				"Number of pages of GIN pending list that triggers pending list cleanup.",
+				"0 disables GIN pending list cleanup.",
+				&pgds_gin_pending_pages,
+				128,
+				0,
+				INT_MAX,
+				PGC_SUSET,
+				0,
+				NULL,
+				NULL,
+				NULL);
+	DefineCustomRealVariable("pgds.vacuum_visible_fraction",
+				"Fraction of all-visible pages below which pgds queues VACUUM of a table with an index supporting index-only scans.",
+				"0 disables VACUUM queueing.",
+				&pgds_vacuum_visible_fraction,
+				0.5,
+				0.0,
+				1.0,
+				PGC_SUSET,
+				0,
+				NULL,
+				NULL,
+				NULL);
+	DefineCustomStringVariable("pgds.standby_conninfo",
+				   "Connection string to a hot standby whose statistics demand is pulled.",
+				   "Empty disables pulling: requires restart to start pgds demand worker.",
+				   &pgds_standby_conninfo,
+				   "",
+				   PGC_SIGHUP,
+				   GUC_SUPERUSER_ONLY,
+				   NULL,
+				   NULL,
+				   NULL);
+	DefineCustomIntVariable("pgds.standby_poll_interval",
+				"Interval between two pulls of standby statistics demand.",
+				NULL,
+				&pgds_standby_poll_interval,
+				60,
+				1,
+				INT_MAX / 1000,
+				PGC_SIGHUP,
+				GUC_UNIT_S,
+				NULL,
+				NULL,
+				NULL);
+#if PG_VERSION_NUM >= 150000
+	MarkGUCPrefixReserved("pgds");
+#else
+	EmitWarningsOnPlaceholders("pgds");
+#endif
+
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = pgds_shmem_request;
+#else
+	pgds_shmem_request();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = pgds_shmem_startup;
+
+	prev_post_parse_analyze_hook = post_parse_analyze_hook;
+	post_parse_analyze_hook = pgds_analyze;
+	prev_ExecutorStart = ExecutorStart_hook;
+	ExecutorStart_hook = pgds_ExecutorStart;
+	prev_ExecutorEnd = ExecutorEnd_hook;
+	ExecutorEnd_hook = pgds_ExecutorEnd;
+	prev_set_rel_pathlist_hook = set_rel_pathlist_hook;
+	set_rel_pathlist_hook = pgds_set_rel_pathlist;
+
+#if PG_VERSION_NUM >= 180000
+	pgds_explain_id = GetExplainExtensionId("pgds");
+	RegisterExtensionExplainOption("pgds", pgds_explain_option);
+	prev_explain_per_plan_hook = explain_per_plan_hook;
+	explain_per_plan_hook = pgds_explain_per_plan;
+#elif PG_VERSION_NUM >= 130000
+	prev_ExplainOneQuery_hook = ExplainOneQuery_hook;
+	ExplainOneQuery_hook = pgds_ExplainOneQuery;
+#endif
+
+	CacheRegisterRelcacheCallback(pgds_relcache_callback, (Datum) 0);
+	CacheRegisterSyscacheCallback(PROCOID, pgds_func_cache_callback, (Datum) 0);
+	CacheRegisterSyscacheCallback(STATRELATTINH, pgds_statistic_callback, (Datum) 0);
+	RegisterXactCallback(pgds_xact_callback, NULL);
+	RegisterSubXactCallback(pgds_subxact_callback, NULL);
+
+#if PG_VERSION_NUM >= 130000
+	/* primary side: pull statistics demand of a standby */
+	if (pgds_standby_conninfo != NULL && pgds_standby_conninfo[0] != '\0')
+	{
+		BackgroundWorker worker;
+
+		memset(&worker, 0, sizeof(worker));
+		worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+		worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+		worker.bgw_restart_time = 60;
+		snprintf(worker.bgw_library_name, BGW_MAXLEN, "pgds");
+		snprintf(worker.bgw_function_name, BGW_MAXLEN, "pgds_demand_worker_main");
+		snprintf(worker.bgw_name, BGW_MAXLEN, "pgds standby demand worker");
+		snprintf(worker.bgw_type, BGW_MAXLEN, "pgds standby demand worker");
+		RegisterBackgroundWorker(&worker);
+	}
+#endif
+
+	elog(DEBUG5, "pgds:_PG_init():exit");
+}
+
+
+/*
+ *  Module unload callback
+ */
+void
+_PG_fini(void)
+{
+	shmem_startup_hook = prev_shmem_startup_hook;	
+	post_parse_analyze_hook = prev_post_parse_analyze_hook;
+	ExecutorStart_hook = prev_ExecutorStart;
+	ExecutorEnd_hook = prev_ExecutorEnd;
+	set_rel_pathlist_hook = prev_set_rel_pathlist_hook;
+#if PG_VERSION_NUM >= 180000
+	explain_per_plan_hook = prev_explain_per_plan_hook;
+#elif PG_VERSION_NUM >= 130000
+	ExplainOneQuery_hook = prev_ExplainOneQuery_hook;
+#endif
+}
+
+static void pgds_add_rel_array(Oid relid)
+{
+	bool found = false;
+	int i;
+
+	if (pgds_func_capture)
+		pgds_func_capture_rels = list_append_unique_oid(pgds_func_capture_rels, relid);
+
+	/*
+	 * tree walkers may find same relation several times
+	 */
+	for (i = 0 ; i < pgds_rel_index; i++)
+	{
+		if (pgds_rel_array[i] == relid) 
+		{
+			found = true;
+			break;
+		}
+	}
+	if (found == true)
+		return;
+
+	if (pgds_rel_index < MAX_REL )
+	{
+		pgds_rel_array[pgds_rel_index] = relid;
+		pgds_rel_index++;
+	} 
+	else elog(DEBUG1, "pgds_add_rel_array: too many relations (%d): %u ignored", MAX_REL, relid);
+}
+
+/*
+ * pgds_add_func_array
+ *
+ * remember user defined SQL function called by statement: system functions
+ * are skipped without catalog lookup
+ */
+static void pgds_add_func_array(Oid funcid)
+{
+	HeapTuple tup;
+	bool sql;
+	int i;
+
+	if (funcid < FirstNormalObjectId)
+		return;
+	if (pgds_func_capture)
+		pgds_func_capture_funcs = list_append_unique_oid(pgds_func_capture_funcs, funcid);
+	for (i = 0; i < pgds_func_index; i++)
+	{
+		if (pgds_func_array[i] == funcid)
+			return;
+	}
+
+	tup = SearchSysCache1(PROCOID, ObjectIdGetDatum(funcid));
+	if (!HeapTupleIsValid(tup))
+		return;
+	sql = ((Form_pg_proc) GETSTRUCT(tup))->prolang == SQLlanguageId;
+	ReleaseSysCache(tup);
+	if (!sql)
+		return;
+
+	if (pgds_func_index < MAX_FUNC)
+	{
+		pgds_func_array[pgds_func_index] = funcid;
+		pgds_func_index++;
+	}
+	else elog(DEBUG1, "pgds_add_func_array: too many functions (%d): %u ignored", MAX_FUNC, funcid);
+}
+
+/*
+ * relation walker state: nodes still to visit are kept on an explicit stack
+ * so that walking deep query trees does not recurse
+ */
+typedef struct pgdsWalkerState
+{
+	List		*stack;
+	Query		*root;
+	HTAB		*visited;
+	int		nqueries;
+	List		*ruled;
+	List		*secured;
+	pgdsPrewarmContext *prewarm;
+} pgdsWalkerState;
+
+/*
+ * pgds_walker_push
+ *
+ * tree walker callback pushing node on walker stack: leaf nodes cannot
+ * contain sublinks and are skipped
+ */
+static bool pgds_walker_push(Node *node, void *context)
+{
+	pgdsWalkerState *state = (pgdsWalkerState *) context;
+
+	if (node == NULL || IsA(node, Const) || IsA(node, Var) ||
+	    IsA(node, Param) || IsA(node, CaseTestExpr))
+		return false;
+
+	state->stack = lappend(state->stack, node);
+	return false;
+}
+
+/*
+ * pgds_walker_first_visit
+ *
+ * returns false if query has already been visited: visited set is only
+ * created for statements having subqueries
+ */
+static bool pgds_walker_first_visit(pgdsWalkerState *state, Query *query)
+{
+	bool found;
+
+	if (state->nqueries == 0)
+	{
+		state->root = query;
+		return true;
+	}
+	if (query == state->root)
+		return false;
+
+	if (state->visited == NULL)
+	{
+		HASHCTL ctl;
+
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(Query *);
+		ctl.entrysize = sizeof(Query *);
+		ctl.hcxt = CurrentMemoryContext;
+		state->visited = hash_create("pgds walker", 64, &ctl,
+					     HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+	(void) hash_search(state->visited, &query, HASH_ENTER, &found);
+
+	return !found;
+}
+
+/*
+ * pgds_walker_push_rewrite
+ *
+ * push row security policy expressions of relation and actions of its rules
+ * fired by query command: relations they reference only enter query tree
+ * in rewriter. Rules and policies of a relation are expanded once per walk
+ * so that they cannot loop through each other.
+ */
+static void pgds_walker_push_rewrite(pgdsWalkerState *state, Query *q, RangeTblEntry *rte, int rti)
+{
+	HeapTuple tup;
+	Form_pg_class classform;
+	bool rules;
+	bool policies;
+	Relation rel;
+	ListCell *lc;
+	int i;
+
+	if (rte->relid < FirstNormalObjectId)
+		return;
+
+	tup = SearchSysCache1(RELOID, ObjectIdGetDatum(rte->relid));
+	if (!HeapTupleIsValid(tup))
+		return;
+	classform = (Form_pg_class) GETSTRUCT(tup);
+	rules = classform->relhasrules && rti == q->resultRelation &&
+		(q->commandType == CMD_INSERT || q->commandType == CMD_UPDATE ||
+		 q->commandType == CMD_DELETE);
+	policies = classform->relrowsecurity;
+	ReleaseSysCache(tup);
+
+	rules = rules && !list_member_oid(state->ruled, rte->relid);
+	policies = policies && !list_member_oid(state->secured, rte->relid);
+	if (!rules && !policies)
+		return;
+	if (rules)
+		state->ruled = lappend_oid(state->ruled, rte->relid);
+	if (policies)
+		state->secured = lappend_oid(state->secured, rte->relid);
+
+	rel = try_relation_open(rte->relid, AccessShareLock);
+	if (rel == NULL)
+		return;
+
+	/* view SELECT rule is expanded by pgds_build_table_array */
+	if (rules && rel->rd_rules != NULL)
+	{
+		for (i = 0; i < rel->rd_rules->numLocks; i++)
+		{
+			RewriteRule *rule = rel->rd_rules->rules[i];
+
+			if (rule->event != q->commandType)
+				continue;
+			(void) pgds_walker_push((Node *) copyObject(rule->qual), state);
+			(void) pgds_walker_push((Node *) copyObject(rule->actions), state);
+		}
+	}
+
+	/* all policies are walked whatever role they apply to */
+	if (policies && rel->rd_rsdesc != NULL)
+	{
+		foreach(lc, rel->rd_rsdesc->policies)
+		{
+			RowSecurityPolicy *policy = (RowSecurityPolicy *) lfirst(lc);
+
+			(void) pgds_walker_push((Node *) copyObject(policy->qual), state);
+			(void) pgds_walker_push((Node *) copyObject(policy->with_check_qual), state);
+		}
+	}
+
+	relation_close(rel, NoLock);
+}
+
+/*
+ * pgds_walk_query
+ *
+ * add all relations referenced by query to pgds_rel_array: range tables,
+ * CTEs, row security policies and rules are walked, each subquery once.
+ * Expressions are walked for queries having sublinks and, outside prewarm
+ * and when database has user SQL functions, to collect SQL functions in
+ * pgds_func_array. Returns number of queries visited.
+ */
+static int pgds_walk_query(Query *query, pgdsPrewarmContext *prewarm)
+{
+	pgdsWalkerState state;
+
+	memset(&state, 0, sizeof(state));
+	state.prewarm = prewarm;
+	if (query != NULL)
+		state.stack = list_make1(query);
+
+	while (state.stack != NIL)
+	{
+		Node *node = (Node *) llast(state.stack);
+
+#if PG_VERSION_NUM >= 130000
+		state.stack = list_delete_last(state.stack);
+#else
+		state.stack = list_truncate(state.stack, list_length(state.stack) - 1);
+#endif
+
+		if (IsA(node, Query))
+		{
+			Query *q = (Query *) node;
+			ListCell *lc;
+			int rti;
+
+			if (!pgds_walker_first_visit(&state, q))
+				continue;
+			state.nqueries++;
+
+			rti = 0;
+			foreach(lc, q->rtable)
+			{
+				RangeTblEntry *rte = (RangeTblEntry *) lfirst(lc);
+
+				rti++;
+				if (rte->rtekind == RTE_RELATION)
+				{
+					pgds_add_rel_array(rte->relid);
+					if (state.prewarm != NULL)
+						pgds_prewarm_add_rte(state.prewarm, q, rte);
+					pgds_walker_push_rewrite(&state, q, rte, rti);
+				}
+				else if (rte->rtekind == RTE_SUBQUERY)
+					(void) pgds_walker_push((Node *) rte->subquery, &state);
+				else if (rte->rtekind == RTE_FUNCTION && state.prewarm == NULL)
+					(void) pgds_walker_push((Node *) rte->functions, &state);
+			}
+
+			foreach(lc, q->cteList)
+			{
+				CommonTableExpr *cte = (CommonTableExpr *) lfirst(lc);
+
+				(void) pgds_walker_push(cte->ctequery, &state);
+			}
+
+			/*
+			 * subqueries of range table and WITH have already been pushed:
+			 * expressions are walked for sublinks, or for SQL functions if
+			 * there can be any
+			 */
+			if (q->hasSubLinks || (state.prewarm == NULL && pgds_has_user_sql_functions()))
+				(void) query_tree_walker(q, pgds_walker_push, &state,
+							 QTW_IGNORE_RC_SUBQUERIES | QTW_IGNORE_JOINALIASES);
+		}
+		else if (IsA(node, SubLink))
+		{
+			SubLink *sub = (SubLink *) node;
+
+			(void) pgds_walker_push(sub->testexpr, &state);
+			(void) pgds_walker_push(sub->subselect, &state);
+		}
+		else if (IsA(node, FuncExpr))
+		{
+			if (state.prewarm == NULL)
+				pgds_add_func_array(((FuncExpr *) node)->funcid);
+			(void) expression_tree_walker(node, pgds_walker_push, &state);
+		}
+		else if (IsA(node, ArrayExpr))
+		{
+			ListCell *lc;
+
+			/* skip constants of long IN lists without going through tree walker */
+			foreach(lc, ((ArrayExpr *) node)->elements)
+			{
+				if (!IsA(lfirst(lc), Const))
+					(void) pgds_walker_push((Node *) lfirst(lc), &state);
+			}
+		}
+		else
+			(void) expression_tree_walker(node, pgds_walker_push, &state);
+	}
+
+	if (state.visited != NULL)
+		hash_destroy(state.visited);
+	list_free(state.ruled);
+	list_free(state.secured);
+
+	return state.nqueries;
+}
+
+/*
+ * build_rel_array
+ */
+static void pgds_build_rel_array(Query *query)
+{
+	(void) pgds_walk_query(query, NULL);
+}
+
+/*
+ * pgds_lookahead_walker
+ *
+ * add tables named in raw parse tree to pgds_rel_array
+ */
+static bool pgds_lookahead_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+
+	if (IsA(node, RangeVar))
+	{
+		/* not locked: statement using it locks it when it is analyzed */
+		Oid	relid = RangeVarGetRelid((RangeVar *) node, NoLock, true);
+
+		if (OidIsValid(relid))
+			pgds_add_rel_array(relid);
+		return false;
+	}
+
+	return raw_expression_tree_walker(node, pgds_lookahead_walker, context);
+}
+
+/*
+ * pgds_lookahead
+ *
+ * add tables of statements following current one in a multi-statement
+ * query string to pgds_rel_array, once per query string: they are checked
+ * with tables of current statement and later statements find them in
+ * pgds_stats_cache. Remaining text is only parsed, not analyzed. Tables
+ * created by a previous statement of the string are not found yet.
+ */
+static void pgds_lookahead(const char *source, Query *query)
+{
+	MemoryContext oldcxt = CurrentMemoryContext;
+	ResourceOwner oldowner = CurrentResourceOwner;
+	const char *rest;
+	int	from;
+
+	/* stmt_len is 0 for last statement */
+	if (source == NULL || query->stmt_location < 0 || query->stmt_len <= 0)
+		return;
+	from = query->stmt_location + query->stmt_len;
+	if (source == pgds_lookahead_source && query->stmt_location >= pgds_lookahead_from)
+		return;
+	pgds_lookahead_source = source;
+	pgds_lookahead_from = from;
+
+	rest = source + from;
+	while (*rest == ';' || scanner_isspace(*rest))
+		rest++;
+	if (*rest == '\0')
+		return;
+
+	BeginInternalSubTransaction(NULL);
+	MemoryContextSwitchTo(oldcxt);
+
+	PG_TRY();
+	{
+		List	*raw;
+		ListCell *lc;
+
+#if PG_VERSION_NUM >= 140000
+		raw = raw_parser(rest, RAW_PARSE_DEFAULT);
+#else
+		raw = raw_parser(rest);
+#endif
+		foreach(lc, raw)
+		{
+			Node	*stmt = lfirst_node(RawStmt, lc)->stmt;
+
+			if (IsA(stmt, ExplainStmt))
+				stmt = ((ExplainStmt *) stmt)->query;
+			if (IsA(stmt, SelectStmt) || IsA(stmt, InsertStmt) ||
+			    IsA(stmt, UpdateStmt) || IsA(stmt, DeleteStmt)
+#if PG_VERSION_NUM >= 150000
+			    || IsA(stmt, MergeStmt)
+#endif
+			    )
+				(void) pgds_lookahead_walker(stmt, NULL);
+		}
+
+		ReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcxt);
+		CurrentResourceOwner = oldowner;
+	}
+	PG_CATCH();
+	{
+		ErrorData *edata;
+
+		MemoryContextSwitchTo(oldcxt);
+		edata = CopyErrorData();
+		FlushErrorState();
+
+		RollbackAndReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcxt);
+		CurrentResourceOwner = oldowner;
+
+		if (edata->sqlerrcode == ERRCODE_QUERY_CANCELED)
+			ReThrowError(edata);
+		elog(DEBUG1, "pgds_lookahead: skipping statements following current one: %s", edata->message);
+		FreeErrorData(edata);
+	}
+	PG_END_TRY();
+}
+
+
+/*
+ *   pgds_get_rel_details
+ */
+static void pgds_get_rel_details(Oid rel_id, char **relname, char** relkind, Oid *relowner)
+{
+	StringInfoData buf_select;	
+	SPITupleTable *tuptable;
+	TupleDesc tupdesc;
+	int ret;
+	int nr;
+	bool isnull;
+
+	initStringInfo(&buf_select);
+	appendStringInfo(&buf_select, 
+				     "select relnamespace, relname, relkind, relowner from pg_class where oid = '%d'", rel_id);
+	pgds_count(PGDS_STAT_CATALOG_PROBES, 1);
+	ret = SPI_execute(buf_select.data, false, 0);
+	if (ret != SPI_OK_SELECT)
+		elog(ERROR, "cannot select from pg_class for rel_id: %d  error code: %d", rel_id, ret);
+	nr = SPI_processed;
+	if (nr == 0)
+		elog(ERROR, "rel_id: %d not found in pg_class", rel_id);
+	if (nr > 1)
+		elog(ERROR, "too many rel.: %d found in pg_class for rel_id: %d" , nr, rel_id);
+	/*
+	 * relname = column 2 for single row result
+	 * relkind = column 3 for single row result
+	 * relowner = column 4 for single row result
+	*/
+	tuptable = SPI_tuptable;
+	tupdesc = tuptable->tupdesc;
+	*relname = SPI_getvalue(tuptable->vals[0], tupdesc, 2);
+	*relkind = SPI_getvalue(tuptable->vals[0], tupdesc, 3);
+	*relowner = DatumGetInt32(SPI_getbinval(tuptable->vals[0], tupdesc, 4, &isnull));
+
+}
+
+/*
+ * pgds_build_table_array
+ */
+static void pgds_build_table_array(Oid rel_id)
+{
+
+	StringInfoData buf_select;	
+	SPITupleTable *tuptable;
+    TupleDesc tupdesc;
+	int j;
+	int nr;
+	int ret;
+	char *relname;
+	char *relkind;
+	Oid relowner;
+	int	ref_rel_id;
+	char *ref_rel_kind;
+	char *ref_rel_name;
+	Oid ref_rel_owner;
+	bool isnull;
+	instr_time start;
+	uint64 us;
+
+	if (rel_id == 0)
+		return;
+	if (pgds_breaker_open(rel_id))
+	{
+		pgds_count(PGDS_STAT_SKIP_BREAKER, 1);
+		return;
+	}
+
+	pgds_current_relid = rel_id;
+	pgds_count(PGDS_STAT_RELS_EXAMINED, 1);
+	INSTR_TIME_SET_CURRENT(start);
+	pgds_get_rel_details(rel_id, &relname, &relkind, &relowner);
+	pgds_phase_record(PGDS_PHASE_CATALOG_LOOKUP, start);
+	elog(DEBUG1, "pgds_build_table_array: reld_id=%d relname=%s, relkind=%s relwoner=%d", rel_id, relname, relkind, relowner);
+
+	if (strcmp(relkind, "r") == 0 || strcmp(relkind, "p") == 0 || strcmp(relkind, "m") == 0)
+	{
+			if (pgds_table_index < MAX_TABLE)
+			{
+				pgds_tableoid_array[pgds_table_index] = rel_id;
+				pgds_tablename_array[pgds_table_index] = relname;
+				pgds_tableowner_array[pgds_table_index] = relowner;
+				pgds_tableforeign_array[pgds_table_index] = false;
+				pgds_table_index++;
+			} 
+			else elog(ERROR, "pgds_build_table_array: too many tables(%d)", MAX_TABLE);
+	} 
+	else if (strcmp(relkind, "f") == 0 && pgds_foreign_sample_rows > 0)
+	{
+		/* foreign table ANALYZE samples remote table: it is only run by workers */
+		if (pgds_table_index < MAX_TABLE)
+		{
+			pgds_tableoid_array[pgds_table_index] = rel_id;
+			pgds_tablename_array[pgds_table_index] = relname;
+			pgds_tableowner_array[pgds_table_index] = relowner;
+			pgds_tableforeign_array[pgds_table_index] = true;
+			pgds_table_index++;
+		}
+		else elog(ERROR, "pgds_build_table_array: too many tables(%d)", MAX_TABLE);
+	}
+	else if (strcmp(relkind, "v") == 0)
+	{
+		/*
+		 * search relations referenced by rel_id view
+		 */	
+		TRACE_PGDS_VIEW_EXPANSION_START(rel_id);
+		INSTR_TIME_SET_CURRENT(start);
+		initStringInfo(&buf_select);
+		appendStringInfo(&buf_select, 
+					    "SELECT * from find_tables(%d)", rel_id);
+		pgds_count(PGDS_STAT_VIEW_EXPANSIONS, 1);
+		pgds_count(PGDS_STAT_CATALOG_PROBES, 1);
+		pgstat_report_wait_start(pgds_we_view_expansion);
+		ret = SPI_execute(buf_select.data, false, 0);
+		pgstat_report_wait_end();
+		if (ret != SPI_OK_SELECT)
+			elog(ERROR, "cannot get dependant relations for rel_id %d: error code: %d", rel_id, ret);
+		nr = SPI_processed;		
+		elog(DEBUG1, "pgds_build_table_array: nr=%d", nr);
+		/*
+		 * column 1 is referenced rel_id
+		 * column 2 is referenced rel_name
+		 * column 3 is referenced rel_kind
+		 * column 4 is referenced rel_owner
+		*/
+	 	tuptable = SPI_tuptable;
+    	tupdesc = tuptable->tupdesc;
+		for (j = 0; j < nr; j++)
+		{
+			elog(DEBUG1, "pgds_build_table_array: j=%d", j);
+			ref_rel_id = DatumGetInt32(SPI_getbinval(tuptable->vals[j],
+							  tupdesc, 1, &isnull));
+			ref_rel_name = SPI_getvalue(tuptable->vals[j],
+							  tupdesc, 2);
+			ref_rel_kind = SPI_getvalue(tuptable->vals[j],
+							  tupdesc, 3);
+			ref_rel_owner = DatumGetInt32(SPI_getbinval(tuptable->vals[j],
+							  tupdesc, 4, &isnull));
+			if (strcmp(ref_rel_kind,"r") == 0 && ref_rel_id != 0)
+			{
+					if (pgds_table_index < MAX_TABLE)
+					{
+						pgds_tableoid_array[pgds_table_index] = ref_rel_id;
+						pgds_tablename_array[pgds_table_index] = ref_rel_name;
+						pgds_tableowner_array[pgds_table_index] = ref_rel_owner;
+						pgds_tableforeign_array[pgds_table_index] = false;
+						pgds_table_index++;
+					} else elog(ERROR, "pgds_build_table_array: too many tables(%d)", MAX_TABLE);
+			}
+		}
+		us = pgds_phase_record(PGDS_PHASE_VIEW_EXPANSION, start);
+		TRACE_PGDS_VIEW_EXPANSION_DONE(rel_id, us);
+		pgds_event(PGDS_EVENT_VIEW_EXPANSION, rel_id, us, false);
+	}
+	else
+	{
+		/* foreign tables, sequences, ... */
+		elog(DEBUG1, "pgds_build_table_array: skipping rel_id: %d with rel_type: %s", rel_id, relkind);
+	}
+
+}
+
+
+/*
+ * pgds_function_queries
+ *
+ * returns parsed statements of SQL function body: pre-parsed body is used
+ * when function has one, function text is parsed otherwise. Functions with
+ * polymorphic arguments are skipped since their argument types are only
+ * known from call.
+ */
+static List *pgds_function_queries(Oid funcid)
+{
+	HeapTuple tup;
+	Form_pg_proc proc;
+	List *result = NIL;
+	Datum d;
+	bool isnull;
+	int i;
+
+	tup = SearchSysCache1(PROCOID, ObjectIdGetDatum(funcid));
+	if (!HeapTupleIsValid(tup))
+		return NIL;
+	proc = (Form_pg_proc) GETSTRUCT(tup);
+	for (i = 0; i < proc->pronargs; i++)
+	{
+		if (IsPolymorphicType(proc->proargtypes.values[i]))
+		{
+			ReleaseSysCache(tup);
+			return NIL;
+		}
+	}
+
+#if PG_VERSION_NUM >= 140000
+	d = SysCacheGetAttr(PROCOID, tup, Anum_pg_proc_prosqlbody, &isnull);
+	if (!isnull)
+	{
+		Node *n = stringToNode(TextDatumGetCString(d));
+
+		/* BEGIN ATOMIC body is a list holding list of statements */
+		if (IsA(n, List))
+			result = list_copy(linitial_node(List, castNode(List, n)));
+		else
+			result = list_make1(n);
+	}
+	else
+#endif
+	{
+		SQLFunctionParseInfoPtr pinfo;
+		char *src;
+		List *raw;
+		ListCell *lc;
+
+		d = SysCacheGetAttr(PROCOID, tup, Anum_pg_proc_prosrc, &isnull);
+		if (isnull)
+		{
+			ReleaseSysCache(tup);
+			return NIL;
+		}
+		src = TextDatumGetCString(d);
+		pinfo = prepare_sql_fn_parse_info(tup, NULL, InvalidOid);
+		raw = pg_parse_query(src);
+		foreach(lc, raw)
+		{
+			RawStmt *rs = lfirst_node(RawStmt, lc);
+
+#if PG_VERSION_NUM >= 150000
+			result = lappend(result, parse_analyze_withcb(rs, src,
+						 (ParserSetupHook) sql_fn_parser_setup, pinfo, NULL));
+#else
+			result = list_concat(result, pg_analyze_and_rewrite_params(rs, src,
+						 (ParserSetupHook) sql_fn_parser_setup, pinfo, NULL));
+#endif
+		}
+	}
+
+	ReleaseSysCache(tup);
+	return result;
+}
+
+/*
+ * pgds_func_cache_forget
+ *
+ * remove cached function entries referencing relid, or having hashvalue:
+ * all entries when both are invalid
+ */
+static void pgds_func_cache_forget(Oid relid, uint32 hashvalue)
+{
+	HASH_SEQ_STATUS status;
+	pgdsFuncRels *entry;
+
+	if (pgds_func_cache == NULL)
+		return;
+
+	hash_seq_init(&status, pgds_func_cache);
+	while ((entry = (pgdsFuncRels *) hash_seq_search(&status)) != NULL)
+	{
+		if (OidIsValid(relid) ? !list_member_oid(entry->rels, relid) :
+		    (hashvalue != 0 && entry->hashvalue != hashvalue))
+			continue;
+		pfree(entry->search_path);
+		list_free(entry->rels);
+		list_free(entry->funcs);
+		(void) hash_search(pgds_func_cache, &entry->funcid, HASH_REMOVE, NULL);
+	}
+}
+
+/*
+ * pgds_func_cache_callback
+ *
+ * forget relations of altered or dropped functions
+ */
+static void
+pgds_func_cache_callback(Datum arg, int cacheid, uint32 hashvalue)
+{
+	pgds_func_cache_forget(InvalidOid, hashvalue);
+	pgds_user_sql_functions = -1;
+}
+
+/*
+ * pgds_has_user_sql_functions
+ *
+ * true if current database has SQL functions created by users: statement
+ * expressions are not walked for SQL function calls otherwise
+ */
+static bool pgds_has_user_sql_functions(void)
+{
+	Relation	rel;
+	SysScanDesc	scan;
+	ScanKeyData	key;
+	HeapTuple	tup;
+
+	if (pgds_user_sql_functions >= 0)
+		return (pgds_user_sql_functions > 0);
+
+	pgds_user_sql_functions = 0;
+	ScanKeyInit(&key, Anum_pg_proc_prolang, BTEqualStrategyNumber, F_OIDEQ,
+		    ObjectIdGetDatum(SQLlanguageId));
+	rel = table_open(ProcedureRelationId, AccessShareLock);
+	scan = systable_beginscan(rel, InvalidOid, false, NULL, 1, &key);
+	while ((tup = systable_getnext(scan)) != NULL)
+	{
+		if (((Form_pg_proc) GETSTRUCT(tup))->oid >= FirstNormalObjectId)
+		{
+			pgds_user_sql_functions = 1;
+			break;
+		}
+	}
+	systable_endscan(scan);
+	table_close(rel, AccessShareLock);
+
+	return (pgds_user_sql_functions > 0);
+}
+
+/*
+ * pgds_func_cache_store
+ *
+ * remember relations and functions referenced by body of funcid
+ */
+static void pgds_func_cache_store(Oid funcid, List *rels, List *funcs)
+{
+	MemoryContext oldcxt;
+	pgdsFuncRels *entry;
+	bool	found;
+
+	if (pgds_func_cache == NULL)
+	{
+		HASHCTL ctl;
+
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(pgdsFuncRels);
+		ctl.hcxt = TopMemoryContext;
+		pgds_func_cache = hash_create("pgds function cache", 64, &ctl,
+					      HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	entry = (pgdsFuncRels *) hash_search(pgds_func_cache, &funcid, HASH_ENTER, &found);
+	oldcxt = MemoryContextSwitchTo(TopMemoryContext);
+	if (found)
+	{
+		pfree(entry->search_path);
+		list_free(entry->rels);
+		list_free(entry->funcs);
+	}
+	entry->hashvalue = GetSysCacheHashValue1(PROCOID, ObjectIdGetDatum(funcid));
+	entry->search_path = pstrdup(namespace_search_path ? namespace_search_path : "");
+	entry->rels = list_copy(rels);
+	entry->funcs = list_copy(funcs);
+	MemoryContextSwitchTo(oldcxt);
+}
+
+/*
+ * pgds_func_cache_lookup
+ *
+ * add cached relations and functions of body of funcid to statement
+ * arrays: returns false if function is not cached
+ */
+static bool pgds_func_cache_lookup(Oid funcid)
+{
+	pgdsFuncRels *entry;
+	List	*rels;
+	List	*funcs;
+	ListCell *lc;
+
+	if (pgds_func_cache == NULL)
+		return false;
+	entry = (pgdsFuncRels *) hash_search(pgds_func_cache, &funcid, HASH_FIND, NULL);
+	if (entry == NULL ||
+	    strcmp(entry->search_path, namespace_search_path ? namespace_search_path : "") != 0)
+		return false;
+
+	/* catalog lookups below may process invalidations removing entry */
+	rels = list_copy(entry->rels);
+	funcs = list_copy(entry->funcs);
+	foreach(lc, rels)
+		pgds_add_rel_array(lfirst_oid(lc));
+	foreach(lc, funcs)
+		pgds_add_func_array(lfirst_oid(lc));
+	list_free(rels);
+	list_free(funcs);
+
+	return true;
+}
+
+/*
+ * pgds_walk_functions
+ *
+ * add relations referenced by bodies of SQL functions called by statement:
+ * functions called by these bodies are appended to pgds_func_array and
+ * walked in turn. A body that cannot be parsed is skipped: each one is
+ * parsed in its own subtransaction, with post_parse_analyze_hook unset so
+ * that other extensions do not see it. Relations found are cached by
+ * pgds_func_cache_store and bodies are only parsed again once function or
+ * one of its relations is invalidated.
+ */
+static void pgds_walk_functions(void)
+{
+	MemoryContext oldcxt = CurrentMemoryContext;
+	ResourceOwner oldowner = CurrentResourceOwner;
+	int i;
+
+	for (i = 0; i < pgds_func_index; i++)
+	{
+		List *queries = NIL;
+		ListCell *lc;
+		bool parsed = false;
+		post_parse_analyze_hook_type saved_hook;
+
+		if (pgds_func_cache_lookup(pgds_func_array[i]))
+			continue;
+
+		BeginInternalSubTransaction(NULL);
+		MemoryContextSwitchTo(oldcxt);
+
+		saved_hook = post_parse_analyze_hook;
+		post_parse_analyze_hook = NULL;
+		PG_TRY();
+		{
+			queries = pgds_function_queries(pgds_func_array[i]);
+			parsed = true;
+			post_parse_analyze_hook = saved_hook;
+
+			ReleaseCurrentSubTransaction();
+			MemoryContextSwitchTo(oldcxt);
+			CurrentResourceOwner = oldowner;
+		}
+		PG_CATCH();
+		{
+			ErrorData *edata;
+
+			post_parse_analyze_hook = saved_hook;
+			MemoryContextSwitchTo(oldcxt);
+			edata = CopyErrorData();
+			FlushErrorState();
+
+			RollbackAndReleaseCurrentSubTransaction();
+			MemoryContextSwitchTo(oldcxt);
+			CurrentResourceOwner = oldowner;
+
+			if (edata->sqlerrcode == ERRCODE_QUERY_CANCELED)
+				ReThrowError(edata);
+			elog(DEBUG1, "pgds_walk_functions: skipping function %u: %s",
+			     pgds_func_array[i], edata->message);
+			FreeErrorData(edata);
+		}
+		PG_END_TRY();
+
+		if (!parsed)
+			continue;
+
+		pgds_func_capture = true;
+		pgds_func_capture_rels = NIL;
+		pgds_func_capture_funcs = NIL;
+		PG_TRY();
+		{
+			foreach(lc, queries)
+				(void) pgds_walk_query((Query *) lfirst(lc), NULL);
+		}
+		PG_CATCH();
+		{
+			pgds_func_capture = false;
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+		pgds_func_capture = false;
+		pgds_func_cache_store(pgds_func_array[i], pgds_func_capture_rels, pgds_func_capture_funcs);
+		list_free(pgds_func_capture_rels);
+		list_free(pgds_func_capture_funcs);
+		pgds_func_capture_rels = NIL;
+		pgds_func_capture_funcs = NIL;
+	}
+}
+
+/*
+ * pgds_cached_table
+ *
+ * true if relid is a table known to have statistics that needs no BRIN, GIN
+ * or VACUUM check: statement relations are already locked by parser. Number
+ * of blocks is kept in pgds_stats_cache entry.
+ */
+static bool pgds_cached_table(Oid relid)
+{
+	pgdsStatsCached *entry;
+	Relation rel;
+	bool	cached;
+
+	if (!pgds_stats_cache_lookup(relid) || pgds_breaker_open(relid))
+		return false;
+
+	rel = try_relation_open(relid, AccessShareLock);
+	if (rel == NULL)
+		return false;
+	/* entry may have been removed by invalidation processed when locking relation */
+	entry = (pgdsStatsCached *) (pgds_stats_cache == NULL ? NULL :
+				     hash_search(pgds_stats_cache, &relid, HASH_FIND, NULL));
+	cached = (entry != NULL &&
+		  (rel->rd_rel->relkind == RELKIND_RELATION ||
+		   rel->rd_rel->relkind == RELKIND_PARTITIONED_TABLE ||
+		   rel->rd_rel->relkind == RELKIND_MATVIEW));
+	if (cached && !RecoveryInProgress())
+	{
+		if (!superuser() && GetUserId() != rel->rd_rel->relowner)
+			cached = false;
+		else if (rel->rd_rel->relkind != RELKIND_PARTITIONED_TABLE)
+		{
+			if ((pgds_brin_summarize_ranges > 0 || pgds_gin_pending_pages > 0) &&
+			    (pgds_noindex_cache == NULL ||
+			     hash_search(pgds_noindex_cache, &relid, HASH_FIND, NULL) == NULL))
+				cached = false;
+			else if (pgds_vacuum_visible_fraction > 0 && rel->rd_rel->relhasindex)
+			{
+				TimestampTz now = GetCurrentStatementStartTimestamp();
+
+				if (entry->sized == 0 ||
+				    TimestampDifferenceExceeds(entry->sized, now, PGDS_NBLOCKS_RECHECK))
+				{
+					entry->nblocks = RelationGetNumberOfBlocks(rel);
+					entry->sized = now;
+				}
+				if (entry->nblocks >= PGDS_VACUUM_MIN_PAGES &&
+				    (BlockNumber) rel->rd_rel->relallvisible < pgds_vacuum_visible_fraction * entry->nblocks)
+					cached = false;
+			}
+		}
+	}
+	relation_close(rel, AccessShareLock);
+
+	return cached;
+}
+
+/*
+ * pgds_cache_hit
+ *
+ * account table found in pgds_stats_cache
+ */
+static void pgds_cache_hit(Oid relid, instr_time check_start)
+{
+	uint64	check_us = pgds_phase_record(PGDS_PHASE_STATS_CHECK, check_start);
+
+	TRACE_PGDS_RELATION_CHECK(relid, false);
+	pgds_count(PGDS_STAT_CACHE_HITS, 1);
+	pgds_count(PGDS_STAT_SKIP_HAS_STATS, 1);
+	pgds_relstat_report(relid, 1, 0, 0, 0, 0, 0);
+	pgds_event(PGDS_EVENT_HAS_STATS, relid, 0, false);
+	pgds_explain_record(relid, PGDS_EVENT_HAS_STATS, check_us);
+}
+
+/*
+ * pgds_process_relations
+ *
+ * check and gather statistics of relations found by tree walker in an
+ * internal subtransaction: errors are reported to server log, accounted by
+ * circuit breaker and do not abort statement. Query cancel is re-thrown.
+ * No subtransaction is started when all relations are cached tables.
+ */
+static void pgds_process_relations(void)
+{
+	MemoryContext oldcxt = CurrentMemoryContext;
+	ResourceOwner oldowner = CurrentResourceOwner;
+	instr_time check_start;
+	int i;
+
+	pgds_current_relid = InvalidOid;
+	for (i = 0; pgds_func_index == 0 && i < pgds_rel_index; i++)
+		if (pgds_rel_array[i] != InvalidOid && !pgds_cached_table(pgds_rel_array[i]))
+			break;
+	if (pgds_func_index == 0 && i == pgds_rel_index)
+	{
+		for (i = 0; i < pgds_rel_index; i++)
+		{
+			if (pgds_rel_array[i] == InvalidOid)
+				continue;
+			INSTR_TIME_SET_CURRENT(check_start);
+			pgds_count(PGDS_STAT_RELS_EXAMINED, 1);
+			pgds_cache_hit(pgds_rel_array[i], check_start);
+		}
+		return;
+	}
+
+	BeginInternalSubTransaction(NULL);
+	MemoryContextSwitchTo(oldcxt);
+
+	PG_TRY();
+	{
+		if (pgds_func_index > 0)
+			pgds_walk_functions();
+		SPI_connect();
+		for (i = 0; i < pgds_rel_index; i++)
+			pgds_build_table_array(pgds_rel_array[i]);
+		pgds_batch_probe();
+		for (i = 0 ; i < pgds_table_index; i++)
+			pgds_analyze_table(i);
+		if ((pgds_brin_summarize_ranges > 0 || pgds_gin_pending_pages > 0) && !RecoveryInProgress())
+			for (i = 0 ; i < pgds_table_index; i++)
+				pgds_index_check(i);
+		if (pgds_vacuum_visible_fraction > 0 && !RecoveryInProgress())
+			for (i = 0 ; i < pgds_table_index; i++)
+				pgds_vacuum_check(i);
+		if (pgds_async_pending)
+		{
+			pgds_async_pending = false;
+			pgds_launch_drainer(MyDatabaseId, GetUserId());
+		}
+		SPI_finish();
+
+		ReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcxt);
+		CurrentResourceOwner = oldowner;
+
+		pgds_breaker_success();
+	}
+	PG_CATCH();
+	{
+		ErrorData *edata;
+
+		MemoryContextSwitchTo(oldcxt);
+		edata = CopyErrorData();
+		FlushErrorState();
+
+		RollbackAndReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcxt);
+		CurrentResourceOwner = oldowner;
+
+		pgds_async_pending = false;
+		if (edata->sqlerrcode == ERRCODE_QUERY_CANCELED)
+		{
+			pgds_avoid_recursion = 0;
+			pgds_rel_index = 0;
+			pgds_func_index = 0;
+			pgds_table_index = 0;
+			ReThrowError(edata);
+		}
+
+		pgds_count(PGDS_STAT_ERRORS, 1);
+		elog(LOG, "pgds: skipping statistics gathering (relation %u): %s",
+		     pgds_current_relid, edata->message);
+		pgds_breaker_failure(pgds_current_relid);
+		FreeErrorData(edata);
+	}
+	PG_END_TRY();
+
+	pgds_current_relid = InvalidOid;
+}
+
+/*
+ *
+ * pgds_analyze: main routine
+ *
+ */
+#if PG_VERSION_NUM < 140000
+static void pgds_analyze(ParseState *pstate, Query *query)
+#else
+static void pgds_analyze(ParseState *pstate, Query *query, JumbleState *js)
+#endif
+{
+	instr_time start;
+	instr_time duration;
+	instr_time walk_start;
+	Query *target;
+
+	/* relations of previous statement must not be shown by EXPLAIN of this one */
+	if (pgds_avoid_recursion == 0)
+		pgds_explain_nrels = 0;
+
+	if (pgds_mode == PGDS_MODE_OFF)
+	{
+		if (prev_post_parse_analyze_hook)
+		{
+#if PG_VERSION_NUM < 140000
+			prev_post_parse_analyze_hook(pstate, query);
+#else
+			prev_post_parse_analyze_hook(pstate, query, js);
+#endif
+		}
+		return;
+	}
+
+	TRACE_PGDS_HOOK_START(query->queryId);
+	INSTR_TIME_SET_CURRENT(start);
+	pgds_count(PGDS_STAT_CALLS, 1);
+	if (pgds_avoid_recursion == 0)
+	{
+		pgds_current_queryid = query->queryId;
+		pgds_event_sampled = (pgds_event_sample_rate >= 1.0 ||
+				      (pgds_event_sample_rate > 0.0 &&
+#if PG_VERSION_NUM >= 150000
+				       pg_prng_double(&pg_global_prng_state) < pgds_event_sample_rate));
+#else
+				       random() < pgds_event_sample_rate * MAX_RANDOM_VALUE));
+#endif
+	}
+
+	/* pstate->p_sourcetext is the current query text */	
+	elog(DEBUG1,"pgds: pgds_analyze: entry: %s",pstate->p_sourcetext);
+
+	if (pgds_avoid_recursion == 0 && pgds_breaker_open(InvalidOid))
+	{
+		pgds_count(PGDS_STAT_SKIP_BREAKER, 1);
+	}
+	else if (pgds_avoid_recursion == 0)
+	{
+		pgds_avoid_recursion = 1;
+		pgds_init_wait_events();
+	
+		/*
+		 *  1. find all tables from all relations
+	 	 *  2. for all tables: check and gather statistics
+	 	 */
+
+		/* post_parse_analyze_hook is not called for explained query: process it here */
+		target = query;
+		if (query->commandType == CMD_UTILITY && query->utilityStmt != NULL &&
+		    IsA(query->utilityStmt, ExplainStmt) &&
+		    IsA(((ExplainStmt *) query->utilityStmt)->query, Query))
+			target = (Query *) ((ExplainStmt *) query->utilityStmt)->query;
+
+		INSTR_TIME_SET_CURRENT(walk_start);
+		pgds_build_rel_array(target);
+		pgds_lookahead(pstate->p_sourcetext, query);
+		pgds_phase_record(PGDS_PHASE_TREE_WALK, walk_start);
+		if (pgds_rel_index > 0 || pgds_func_index > 0)
+			pgds_process_relations();
+
+		pgds_avoid_recursion = 0;
+
+		pgds_rel_index = 0;
+		pgds_func_index = 0;
+		pgds_table_index = 0;
+
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, start);
+		pgds_event(PGDS_EVENT_STATEMENT, InvalidOid, INSTR_TIME_GET_MICROSEC(duration), false);
+	}
+	else
+	{
+		pgds_count(PGDS_STAT_SKIP_RECURSION, 1);
+		elog(DEBUG1, "pgds: pgds_analyze: return");
+	}
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	pgds_count(PGDS_STAT_TIME_US, INSTR_TIME_GET_MICROSEC(duration));
+	TRACE_PGDS_HOOK_DONE(query->queryId, INSTR_TIME_GET_MICROSEC(duration));
+
+	if (prev_post_parse_analyze_hook)
+	{
+#if PG_VERSION_NUM < 140000
+		prev_post_parse_analyze_hook(pstate, query);
+#else
+		prev_post_parse_analyze_hook(pstate, query, js);
+#endif
+	 }
+
+	elog(DEBUG1, "pgds: pgds_analyze: exit");
+}
+
+
+/*
+ * pgds_provisional_save
+ *
+ * write provisional relations to PGDS_PROVISIONAL_FILE so that they are
+ * still analyzed after a restart: called at postmaster shutdown
+ */
+static void pgds_provisional_save(void)
+{
+	FILE		*file;
+	uint32		header = PGDS_PROVISIONAL_HEADER;
+
+	file = AllocateFile(PGDS_PROVISIONAL_FILE ".tmp", PG_BINARY_W);
+	if (file == NULL ||
+	    fwrite(&header, sizeof(uint32), 1, file) != 1 ||
+	    fwrite(pgds->provisional, sizeof(pgds->provisional), 1, file) != 1)
+	{
+		elog(LOG, "pgds: could not write file \"%s\": %m", PGDS_PROVISIONAL_FILE ".tmp");
+		if (file)
+			FreeFile(file);
+		unlink(PGDS_PROVISIONAL_FILE ".tmp");
+		return;
+	}
+	if (FreeFile(file))
+	{
+		elog(LOG, "pgds: could not write file \"%s\": %m", PGDS_PROVISIONAL_FILE ".tmp");
+		unlink(PGDS_PROVISIONAL_FILE ".tmp");
+		return;
+	}
+
+	(void) durable_rename(PGDS_PROVISIONAL_FILE ".tmp", PGDS_PROVISIONAL_FILE, LOG);
+}
+
+/*
+ * pgds_provisional_load
+ *
+ * read provisional relations saved by pgds_provisional_save: called once at
+ * shared memory initialization. File is kept: after a crash, relations of
+ * last shutdown are analyzed again.
+ */
+static void pgds_provisional_load(void)
+{
+	FILE		*file;
+	uint32		header;
+
+	file = AllocateFile(PGDS_PROVISIONAL_FILE, PG_BINARY_R);
+	if (file == NULL)
+	{
+		if (errno != ENOENT)
+			elog(LOG, "pgds: could not read file \"%s\": %m", PGDS_PROVISIONAL_FILE);
+		return;
+	}
+
+	if (fread(&header, sizeof(uint32), 1, file) != 1 || header != PGDS_PROVISIONAL_HEADER ||
+	    fread(pgds->provisional, sizeof(pgds->provisional), 1, file) != 1)
+	{
+		elog(LOG, "pgds: ignoring invalid file \"%s\"", PGDS_PROVISIONAL_FILE);
+		memset(pgds->provisional, 0, sizeof(pgds->provisional));
+	}
+	FreeFile(file);
+}
+
+/*
+ * pgds_provisional_mark
+ *
+ * remember that relid only has quick statistics: oldest entry is replaced
+ * when all entries are used
+ */
+static void pgds_provisional_mark(Oid relid, int ncolumns)
+{
+	pgdsProvisional *slot = NULL;
+	int i;
+
+	LWLockAcquire(pgds->lock, LW_EXCLUSIVE);
+	for (i = 0; i < PGDS_PROVISIONAL; i++)
+	{
+		pgdsProvisional *p = &pgds->provisional[i];
+
+		if (p->relid == InvalidOid || (p->dboid == MyDatabaseId && p->relid == relid))
+		{
+			slot = p;
+			break;
+		}
+		if (slot == NULL || p->created < slot->created)
+			slot = p;
+	}
+	slot->dboid = MyDatabaseId;
+	slot->relid = relid;
+	slot->ncolumns = ncolumns;
+	slot->created = GetCurrentTimestamp();
+	LWLockRelease(pgds->lock);
+}
+
+/*
+ * pgds_provisional_clear
+ *
+ * relid has been analyzed: its quick statistics have been replaced
+ */
+static void pgds_provisional_clear(Oid relid)
+{
+	int i;
+
+	if (pgds == NULL)
+		return;
+
+	LWLockAcquire(pgds->lock, LW_EXCLUSIVE);
+	for (i = 0; i < PGDS_PROVISIONAL; i++)
+	{
+		pgdsProvisional *p = &pgds->provisional[i];
+
+		if (p->dboid == MyDatabaseId && p->relid == relid)
+			memset(p, 0, sizeof(pgdsProvisional));
+	}
+	LWLockRelease(pgds->lock);
+}
+
+/*
+ * pgds_provisional_lookup
+ *
+ * true if relid only has quick statistics
+ */
+static bool pgds_provisional_lookup(Oid relid)
+{
+	bool	found = false;
+	int i;
+
+	if (pgds == NULL)
+		return false;
+
+	LWLockAcquire(pgds->lock, LW_SHARED);
+	for (i = 0; i < PGDS_PROVISIONAL && !found; i++)
+		found = (pgds->provisional[i].dboid == MyDatabaseId && pgds->provisional[i].relid == relid);
+	LWLockRelease(pgds->lock);
+
+	return found;
+}
+
+#if PG_VERSION_NUM >= 130000
+#if PG_VERSION_NUM < 150000
+#define BTPageGetOpaque(page) ((BTPageOpaque) PageGetSpecialPointer(page))
+#endif
+
+/*
+ * pgds_quick_index_end
+ *
+ * leading column of first (or last) heap tuple visible to transaction
+ * snapshot found by btree index scan with flags SK_SEARCHNOTNULL or
+ * SK_SEARCHNULL: keys of dead or aborted tuples are skipped. Returns false
+ * if index holds no such visible tuple.
+ */
+static bool pgds_quick_index_end(Relation heaprel, Relation idxrel, ScanDirection dir, int flags, Datum *value)
+{
+	Form_pg_attribute att = TupleDescAttr(RelationGetDescr(heaprel), idxrel->rd_index->indkey.values[0] - 1);
+	IndexScanDesc scan;
+	ScanKeyData key;
+	TupleTableSlot *slot;
+	bool	found = false;
+	bool	isnull;
+
+	ScanKeyEntryInitialize(&key, SK_ISNULL | flags, 1,
+			       InvalidStrategy, InvalidOid, InvalidOid, InvalidOid, (Datum) 0);
+	slot = table_slot_create(heaprel, NULL);
+#if PG_VERSION_NUM >= 180000
+	scan = index_beginscan(heaprel, idxrel, GetTransactionSnapshot(), NULL, 1, 0);
+#else
+	scan = index_beginscan(heaprel, idxrel, GetTransactionSnapshot(), 1, 0);
+#endif
+	index_rescan(scan, &key, 1, NULL, 0);
+	if (index_getnext_slot(scan, dir, slot))
+	{
+		found = true;
+		*value = slot_getattr(slot, att->attnum, &isnull);
+		if (!isnull)
+			*value = datumCopy(*value, att->attbyval, att->attlen);
+	}
+	index_endscan(scan);
+	ExecDropSingleTupleTableSlot(slot);
+
+	return found;
+}
+
+/*
+ * pgds_quick_index_pivots
+ *
+ * leading column values of pivot keys of the highest index level having at
+ * least target pivots, or of the lowest level read within
+ * PGDS_QUICK_STATS_PAGES pages. Subtrees between two pivots of a level hold
+ * about the same number of leaf pages, so pivots approximate equi-depth
+ * histogram bounds. Returns number of pivots.
+ */
+static int pgds_quick_index_pivots(Relation idxrel, int target, Datum **pivots)
+{
+	Form_pg_attribute att = TupleDescAttr(RelationGetDescr(idxrel), 0);
+	BlockNumber *blocks;
+	BlockNumber *children;
+	int	nblocks;
+	int	nchildren;
+	int	npivots = 0;
+	int	pages = 1;
+	uint32	level;
+	Buffer	buf;
+	BTMetaPageData *metad;
+
+	buf = ReadBuffer(idxrel, BTREE_METAPAGE);
+	LockBuffer(buf, BT_READ);
+	metad = BTPageGetMeta(BufferGetPage(buf));
+	blocks = palloc(sizeof(BlockNumber) * PGDS_QUICK_STATS_PAGES);
+	blocks[0] = metad->btm_fastroot;
+	level = metad->btm_fastlevel;
+	UnlockReleaseBuffer(buf);
+	if (blocks[0] == P_NONE || level == 0)
+		return 0;
+	nblocks = 1;
+
+	children = palloc(sizeof(BlockNumber) * PGDS_QUICK_STATS_PAGES);
+	*pivots = NULL;
+	for (;;)
+	{
+		Datum	*values = NULL;
+		int	nvalues = 0;
+		int	i;
+
+		nchildren = 0;
+		for (i = 0; i < nblocks; i++)
+		{
+			Page	page;
+			BTPageOpaque opaque;
+			OffsetNumber off;
+			OffsetNumber maxoff;
+
+			buf = ReadBuffer(idxrel, blocks[i]);
+			LockBuffer(buf, BT_READ);
+			page = BufferGetPage(buf);
+			opaque = BTPageGetOpaque(page);
+			if (P_IGNORE(opaque) || P_ISLEAF(opaque))
+			{
+				UnlockReleaseBuffer(buf);
+				continue;
+			}
+			maxoff = PageGetMaxOffsetNumber(page);
+			if (values == NULL)
+				values = palloc(sizeof(Datum) * (maxoff + 1));
+			else
+				values = repalloc(values, sizeof(Datum) * (nvalues + maxoff + 1));
+
+			/* first data key is minus infinity, high key separates page from its right sibling */
+			for (off = P_FIRSTDATAKEY(opaque); off <= maxoff; off++)
+			{
+				IndexTuple itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, off));
+
+				if (nchildren < PGDS_QUICK_STATS_PAGES)
+					children[nchildren++] = BTreeTupleGetDownLink(itup);
+				if (off > P_FIRSTDATAKEY(opaque))
+				{
+					Datum	d;
+					bool	isnull;
+
+					d = index_getattr(itup, 1, RelationGetDescr(idxrel), &isnull);
+					if (!isnull)
+						values[nvalues++] = datumCopy(d, att->attbyval, att->attlen);
+				}
+			}
+			if (!P_RIGHTMOST(opaque))
+			{
+				IndexTuple itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, P_HIKEY));
+				Datum	d;
+				bool	isnull;
+
+				d = index_getattr(itup, 1, RelationGetDescr(idxrel), &isnull);
+				if (!isnull)
+					values[nvalues++] = datumCopy(d, att->attbyval, att->attlen);
+			}
+			UnlockReleaseBuffer(buf);
+		}
+
+		if (nvalues > 0)
+		{
+			*pivots = values;
+			npivots = nvalues;
+		}
+		level--;
+		if (npivots >= target || level == 0 || nchildren == 0 ||
+		    pages + nblocks + nchildren > PGDS_QUICK_STATS_PAGES)
+			break;
+
+		pages += nblocks;
+		memcpy(blocks, children, sizeof(BlockNumber) * nchildren);
+		nblocks = nchildren;
+	}
+
+	return npivots;
+}
+
+/*
+ * pgds_quick_column_stats
+ *
+ * store provisional pg_statistic row of leading column of btree index built
+ * from its first and last keys and its pivot keys: histogram bounds, and
+ * n_distinct if index is unique on this column only. Returns false if index
+ * cannot be used or column already has statistics.
+ */
+static bool pgds_quick_column_stats(Relation heaprel, Relation idxrel)
+{
+	Datum		values[Natts_pg_statistic];
+	bool		nulls[Natts_pg_statistic];
+	AttrNumber	attnum = idxrel->rd_index->indkey.values[0];
+	Form_pg_attribute att;
+	TypeCacheEntry	*typentry;
+	Datum		*pivots;
+	Datum		*bounds;
+	int		npivots;
+	int		nbounds;
+	int		target;
+	int		i;
+	int16		typlen;
+	bool		typbyval;
+	char		typalign;
+	Relation	sd;
+	HeapTuple	stup;
+
+	if (attnum <= 0 || !idxrel->rd_index->indisvalid || idxrel->rd_indoption[0] != 0 ||
+	    RelationGetIndexPredicate(idxrel) != NIL)
+		return false;
+
+	att = TupleDescAttr(RelationGetDescr(heaprel), attnum - 1);
+	typentry = lookup_type_cache(att->atttypid, TYPECACHE_LT_OPR | TYPECACHE_BTREE_OPFAMILY);
+	if (TupleDescAttr(RelationGetDescr(idxrel), 0)->atttypid != att->atttypid ||
+	    idxrel->rd_opfamily[0] != typentry->btree_opf || !OidIsValid(typentry->lt_opr) ||
+	    idxrel->rd_indcollation[0] != att->attcollation)
+		return false;
+
+	stup = SearchSysCache3(STATRELATTINH, ObjectIdGetDatum(RelationGetRelid(heaprel)),
+			       Int16GetDatum(attnum), BoolGetDatum(false));
+	if (HeapTupleIsValid(stup))
+	{
+		ReleaseSysCache(stup);
+		return false;
+	}
+
+#if PG_VERSION_NUM >= 170000
+	target = default_statistics_target;
+#else
+	target = (att->attstattarget > 0) ? att->attstattarget : default_statistics_target;
+#endif
+	if (target < 2)
+		return false;
+
+	/* a column holding nulls keeps no statistics: null fraction is unknown */
+	bounds = palloc(sizeof(Datum) * (target + 1));
+	if ((!att->attnotnull &&
+	     pgds_quick_index_end(heaprel, idxrel, ForwardScanDirection, SK_SEARCHNULL, &bounds[0])) ||
+	    !pgds_quick_index_end(heaprel, idxrel, ForwardScanDirection, SK_SEARCHNOTNULL, &bounds[0]))
+		return false;
+	npivots = pgds_quick_index_pivots(idxrel, target - 1, &pivots);
+	if (npivots == 0)
+		return false;
+
+	/* min, target - 1 evenly spaced pivots, max */
+	nbounds = 1;
+	for (i = 0; i < Min(npivots, target - 1); i++)
+		bounds[nbounds++] = pivots[(int64) (i + 1) * npivots / (Min(npivots, target - 1) + 1)];
+	if (!pgds_quick_index_end(heaprel, idxrel, BackwardScanDirection, SK_SEARCHNOTNULL, &bounds[nbounds]))
+		return false;
+	nbounds++;
+
+	memset(nulls, false, sizeof(nulls));
+	values[Anum_pg_statistic_starelid - 1] = ObjectIdGetDatum(RelationGetRelid(heaprel));
+	values[Anum_pg_statistic_staattnum - 1] = Int16GetDatum(attnum);
+	values[Anum_pg_statistic_stainherit - 1] = BoolGetDatum(false);
+	values[Anum_pg_statistic_stanullfrac - 1] = Float4GetDatum(0.0);
+	values[Anum_pg_statistic_stawidth - 1] = Int32GetDatum(get_typavgwidth(att->atttypid, att->atttypmod));
+	/* 0 is unknown number of distinct values: planner uses its default */
+	values[Anum_pg_statistic_stadistinct - 1] =
+		Float4GetDatum((idxrel->rd_index->indisunique && IndexRelationGetNumberOfKeyAttributes(idxrel) == 1) ? -1.0 : 0.0);
+	for (i = 0; i < STATISTIC_NUM_SLOTS; i++)
+	{
+		values[Anum_pg_statistic_stakind1 - 1 + i] = Int16GetDatum(0);
+		values[Anum_pg_statistic_staop1 - 1 + i] = ObjectIdGetDatum(InvalidOid);
+		values[Anum_pg_statistic_stacoll1 - 1 + i] = ObjectIdGetDatum(InvalidOid);
+		nulls[Anum_pg_statistic_stanumbers1 - 1 + i] = true;
+		nulls[Anum_pg_statistic_stavalues1 - 1 + i] = true;
+	}
+	get_typlenbyvalalign(att->atttypid, &typlen, &typbyval, &typalign);
+	values[Anum_pg_statistic_stakind1 - 1] = Int16GetDatum(STATISTIC_KIND_HISTOGRAM);
+	values[Anum_pg_statistic_staop1 - 1] = ObjectIdGetDatum(typentry->lt_opr);
+	values[Anum_pg_statistic_stacoll1 - 1] = ObjectIdGetDatum(att->attcollation);
+	values[Anum_pg_statistic_stavalues1 - 1] =
+		PointerGetDatum(construct_array(bounds, nbounds, att->atttypid, typlen, typbyval, typalign));
+	nulls[Anum_pg_statistic_stavalues1 - 1] = false;
+
+	sd = table_open(StatisticRelationId, RowExclusiveLock);
+	stup = heap_form_tuple(RelationGetDescr(sd), values, nulls);
+	CatalogTupleInsert(sd, stup);
+	heap_freetuple(stup);
+	table_close(sd, RowExclusiveLock);
+
+	return true;
+}
+
+/*
+ * pgds_quick_stats
+ *
+ * build quick statistics of leading columns of btree indexes of relid if
+ * it has at least pgds.quick_stats_min_pages pages. Returns number of
+ * columns having quick statistics.
+ */
+static int pgds_quick_stats(Oid relid)
+{
+	Relation	heaprel;
+	List		*indexes;
+	ListCell	*lc;
+	int		ncolumns = 0;
+
+	heaprel = try_relation_open(relid, AccessShareLock);
+	if (heaprel == NULL)
+		return 0;
+	if ((heaprel->rd_rel->relkind != RELKIND_RELATION && heaprel->rd_rel->relkind != RELKIND_MATVIEW) ||
+	    RelationGetNumberOfBlocks(heaprel) < (BlockNumber) pgds_quick_stats_min_pages)
+	{
+		relation_close(heaprel, AccessShareLock);
+		return 0;
+	}
+
+	indexes = RelationGetIndexList(heaprel);
+	foreach(lc, indexes)
+	{
+		Relation idxrel = index_open(lfirst_oid(lc), AccessShareLock);
+
+		if (idxrel->rd_rel->relam == BTREE_AM_OID && pgds_quick_column_stats(heaprel, idxrel))
+		{
+			/* next index on same column finds this row */
+			CommandCounterIncrement();
+			ncolumns++;
+		}
+		index_close(idxrel, AccessShareLock);
+	}
+	list_free(indexes);
+	relation_close(heaprel, AccessShareLock);
+
+	return ncolumns;
+}
+#endif
+
+/*
+ * pgds_stats_probe_expr
+ *
+ * expression returning number of pg_statistic rows of relation relexpr, or 0
+ * if one of its expression indexes has no statistics: expression statistics
+ * are only built by ANALYZE of the table, so an expression index created
+ * after the table was analyzed has none. Indexes having a column with
+ * statistics target 0 are never analyzed and are ignored, as are partial
+ * indexes: ANALYZE builds no statistics for them when no sampled row matches
+ * their predicate.
+ */
+static char *pgds_stats_probe_expr(const char *relexpr)
+{
+	return psprintf("case when exists (select 1 from pg_index i join pg_class c on c.oid = i.indexrelid"
+			" where i.indrelid = %s and i.indexprs is not null and i.indpred is null and i.indisvalid and c.relkind = 'i'"
+			" and not exists (select 1 from pg_statistic s where s.starelid = i.indexrelid)"
+			" and not exists (select 1 from pg_attribute a where a.attrelid = i.indexrelid and a.attstattarget = 0))"
+			" then 0 else (select count(*) from pg_statistic where starelid = %s) end",
+			relexpr, relexpr);
+}
+
+/*
+ * pgds_stats_probe_query
+ *
+ * query returning pgds_stats_probe_expr for relid
+ */
+static char *pgds_stats_probe_query(Oid relid)
+{
+	char	relexpr[16];
+
+	snprintf(relexpr, sizeof(relexpr), "%u", relid);
+	return psprintf("select %s", pgds_stats_probe_expr(relexpr));
+}
+
+/*
+ * pgds_batch_probe
+ *
+ * probe pg_statistic with a single query for all tables of statement that
+ * pgds_analyze_table would probe: it then uses pgds_tableprobe_array
+ * instead of running its own probe. Nothing is done when at most one table
+ * needs a probe.
+ */
+static void pgds_batch_probe(void)
+{
+	StringInfoData buf;
+	int	nprobes = 0;
+	int	ret;
+	uint64	row;
+	int	i;
+
+	initStringInfo(&buf);
+	for (i = 0; i < pgds_table_index; i++)
+	{
+		pgds_tableprobe_array[i] = -1;
+		if (pgds_breaker_open(pgds_tableoid_array[i]) ||
+		    (!RecoveryInProgress() && !superuser() && GetUserId() != pgds_tableowner_array[i]) ||
+		    pgds_stats_cache_lookup(pgds_tableoid_array[i]))
+			continue;
+		appendStringInfo(&buf, "%s%u", nprobes == 0 ? "" : ",", pgds_tableoid_array[i]);
+		nprobes++;
+	}
+	if (nprobes < 2)
+	{
+		pfree(buf.data);
+		return;
+	}
+
+	pgds_count(PGDS_STAT_CATALOG_PROBES, 1);
+	pgds_count(PGDS_STAT_BATCHED_PROBES, nprobes);
+	ret = SPI_execute(psprintf("select r.oid, %s from unnest('{%s}'::oid[]) as r(oid)",
+				   pgds_stats_probe_expr("r.oid"), buf.data), true, 0);
+	if (ret != SPI_OK_SELECT)
+		elog(ERROR, "cannot select from pg_statistic: error code: %d", ret);
+
+	for (row = 0; row < SPI_processed; row++)
+	{
+		HeapTuple tuple = SPI_tuptable->vals[row];
+		TupleDesc tupdesc = SPI_tuptable->tupdesc;
+		bool	isnull;
+		Oid	relid = DatumGetObjectId(SPI_getbinval(tuple, tupdesc, 1, &isnull));
+		int64	count = DatumGetInt64(SPI_getbinval(tuple, tupdesc, 2, &isnull));
+
+		/* a table listed twice is probed again once first one is processed */
+		for (i = 0; i < pgds_table_index; i++)
+			if (pgds_tableoid_array[i] == relid)
+			{
+				pgds_tableprobe_array[i] = count;
+				break;
+			}
+	}
+	pfree(buf.data);
+}
+
+/*
+ * pgds_analyze_queue
+ *
+ * queue ANALYZE of table for pgds workers: if missing, worker skips it
+ * when table has statistics by then. stale is set for a table having quick
+ * statistics only.
+ */
+static void pgds_analyze_queue(int index, bool missing, bool stale)
+{
+	pgdsWorkItem item;
+
+	memset(&item, 0, sizeof(item));
+	/* several backends may queue same foreign table before it is analyzed */
+	item.kind = (missing || pgds_tableforeign_array[index]) ? PGDS_WORK_ANALYZE_MISSING : PGDS_WORK_ANALYZE;
+	item.dboid = MyDatabaseId;
+	item.userid = GetUserId();
+	item.relid = pgds_tableoid_array[index];
+	if (pgds_enqueue_work(&item))
+		pgds_async_pending = true;
+	else
+		elog(DEBUG1, "pgds: work queue is full: %s not queued", pgds_tablename_array[index]);
+	pgds_relstat_report(pgds_tableoid_array[index], 1, stale ? 0 : 1, stale ? 1 : 0, 0, 0, 0);
+	pgds_event(PGDS_EVENT_QUEUED, pgds_tableoid_array[index], 0, false);
+	pgds_explain_record(pgds_tableoid_array[index], PGDS_EVENT_QUEUED, 0);
+}
+
+/*
+ *
+ * pgds_analyze_table
+ * 
+ */
+static void pgds_analyze_table(int index)
+{
+	
+	StringInfoData buf_select;
+	StringInfoData buf_analyze;
+	SPITupleTable *tuptable;
+    TupleDesc tupdesc;
+    char *count_val;
+	int ret;
+	instr_time check_start;
+	uint64 check_us;
+
+	if (pgds_breaker_open(pgds_tableoid_array[index]))
+	{
+		pgds_count(PGDS_STAT_SKIP_BREAKER, 1);
+		return;
+	}
+	pgds_current_relid = pgds_tableoid_array[index];
+
+	/* on a standby relation is not analyzed here: ownership does not matter */
+	if (!RecoveryInProgress() && !superuser() && GetUserId() != pgds_tableowner_array[index])
+	{
+		elog (INFO, "pgds_analyze_table: current user cannot analyze %s", pgds_tablename_array[index]);
+		pgds_count(PGDS_STAT_SKIP_NOT_OWNER, 1);
+		pgds_relstat_report(pgds_tableoid_array[index], 1, 0, 0, 0, 0, 0);
+		pgds_event(PGDS_EVENT_NOT_OWNER, pgds_tableoid_array[index], 0, false);
+		pgds_explain_record(pgds_tableoid_array[index], PGDS_EVENT_NOT_OWNER, 0);
+		return;
+	}
+
+	INSTR_TIME_SET_CURRENT(check_start);
+	if (pgds_stats_cache_lookup(pgds_tableoid_array[index]))
+	{
+		pgds_cache_hit(pgds_tableoid_array[index], check_start);
+		return;
+	}
+	pgds_count(PGDS_STAT_CACHE_MISSES, 1);
+
+	initStringInfo(&buf_select);
+	appendStringInfoString(&buf_select, pgds_stats_probe_query(pgds_tableoid_array[index]));
+	if (pgds_tableprobe_array[index] >= 0)
+		/* probed by pgds_batch_probe */
+		count_val = psprintf(INT64_FORMAT, pgds_tableprobe_array[index]);
+	else
+	{
+		pgds_count(PGDS_STAT_CATALOG_PROBES, 1);
+		ret = SPI_execute(buf_select.data, false, 0);
+		if (ret != SPI_OK_SELECT)
+			elog(ERROR, "cannot select from pg_statistic for rel_id: %d  error code: %d", pgds_tableoid_array[index], ret);
+		/*
+		** count(*) returns only 1 row with 1 column
+		*/
+		tuptable = SPI_tuptable;
+		tupdesc = tuptable->tupdesc;
+		count_val = SPI_getvalue(tuptable->vals[0], tupdesc, 1);
+	}
+	check_us = pgds_phase_record(PGDS_PHASE_STATS_CHECK, check_start);
+	pgds_explain_record(pgds_tableoid_array[index], PGDS_EVENT_HAS_STATS, check_us);
+	elog(DEBUG1,"pgds: pgds_analyze_table: oid: %d  tablename: %s count_val: %s", 
+	             pgds_tableoid_array[index], pgds_tablename_array[index], count_val);
+	TRACE_PGDS_RELATION_CHECK(pgds_tableoid_array[index], strcmp(count_val, "0") == 0);
+
+	if (strcmp(count_val, "0") == 0 && RecoveryInProgress())
+	{
+		/* ANALYZE cannot run during recovery: leave it to the primary */
+		pgds_demand_record(pgds_tableoid_array[index], pgds_tableowner_array[index]);
+		pgds_count(PGDS_STAT_STANDBY_DEMANDS, 1);
+		pgds_relstat_report(pgds_tableoid_array[index], 1, 1, 0, 0, 0, 0);
+		pgds_event(PGDS_EVENT_STANDBY_DEMAND, pgds_tableoid_array[index], 0, false);
+		pgds_explain_record(pgds_tableoid_array[index], PGDS_EVENT_STANDBY_DEMAND, 0);
+		return;
+	}
+
+#if PG_VERSION_NUM >= 130000
+	if (strcmp(count_val, "0") == 0 && !pgds_tableforeign_array[index] &&
+	    pgds_quick_stats_min_pages > 0 && pgds != NULL &&
+	    pgds_inflight_claim(pgds_tableoid_array[index]))
+	{
+		instr_time start;
+		int ncolumns;
+
+		/* large table: planner uses quick statistics until a worker has analyzed it */
+		INSTR_TIME_SET_CURRENT(start);
+		ncolumns = pgds_quick_stats(pgds_tableoid_array[index]);
+		if (ncolumns > 0)
+		{
+			pgdsWorkItem item;
+			uint64 us;
+
+			CommandCounterIncrement();
+			us = pgds_phase_record(PGDS_PHASE_ANALYZE, start);
+			pgds_provisional_mark(pgds_tableoid_array[index], ncolumns);
+			pgds_count(PGDS_STAT_QUICK_STATS, 1);
+			pgds_event(PGDS_EVENT_QUICK_STATS, pgds_tableoid_array[index], us, true);
+			pgds_explain_record(pgds_tableoid_array[index], PGDS_EVENT_QUICK_STATS, us);
+
+			memset(&item, 0, sizeof(item));
+			item.kind = PGDS_WORK_ANALYZE;
+			item.dboid = MyDatabaseId;
+			item.userid = GetUserId();
+			item.relid = pgds_tableoid_array[index];
+			if (pgds_enqueue_work(&item))
+				pgds_async_pending = true;
+			else
+				elog(DEBUG1, "pgds: work queue is full: %s not queued", pgds_tablename_array[index]);
+			pgds_relstat_report(pgds_tableoid_array[index], 1, 1, 0, 0, 0, 0);
+			return;
+		}
+	}
+#endif
+
+	if (strcmp(count_val, "0") == 0 && pgds_tableforeign_array[index] && pgds != NULL &&
+	    pgds_inflight_busy(pgds_tableoid_array[index]))
+	{
+		/* a worker is sampling the remote table */
+		elog(DEBUG1, "pgds: %s is being analyzed: not queued", pgds_tablename_array[index]);
+		pgds_relstat_report(pgds_tableoid_array[index], 1, 1, 0, 0, 0, 0);
+		return;
+	}
+
+	if (strcmp(count_val, "0") == 0 &&
+	    (pgds_mode == PGDS_MODE_ASYNC || pgds_tableforeign_array[index]))
+	{
+		pgds_analyze_queue(index, false, false);
+		return;
+	}
+
+	if (strcmp(count_val, "0") == 0 && !pgds_inflight_claim(pgds_tableoid_array[index]))
+	{
+		instr_time wait_start;
+		instr_time wait_duration;
+		bool waited;
+
+		/* another backend is analyzing this table: wait for its statistics */
+		INSTR_TIME_SET_CURRENT(wait_start);
+		waited = pgds_inflight_wait(pgds_tableoid_array[index]);
+		INSTR_TIME_SET_CURRENT(wait_duration);
+		INSTR_TIME_SUBTRACT(wait_duration, wait_start);
+		pgds_event(PGDS_EVENT_ANALYZE_WAIT, pgds_tableoid_array[index],
+			   INSTR_TIME_GET_MICROSEC(wait_duration), false);
+		pgds_explain_record(pgds_tableoid_array[index], PGDS_EVENT_ANALYZE_WAIT,
+				    INSTR_TIME_GET_MICROSEC(wait_duration));
+		if (waited)
+		{
+			pgds_count(PGDS_STAT_CATALOG_PROBES, 1);
+			ret = SPI_execute(buf_select.data, false, 0);
+			if (ret != SPI_OK_SELECT)
+				elog(ERROR, "cannot select from pg_statistic for rel_id: %d  error code: %d", pgds_tableoid_array[index], ret);
+			count_val = SPI_getvalue(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1);
+		}
+		if (strcmp(count_val, "0") == 0)
+			(void) pgds_inflight_claim(pgds_tableoid_array[index]);
+	}
+
+	if (strcmp(count_val, "0") == 0 &&
+	    (pgds_governor_overloaded() || !pgds_governor_admit()))
+	{
+		/*
+		 * analysis would exceed governor limits: leave it to a worker and
+		 * release relation, backends needing it must not wait for this one
+		 */
+		pgds_inflight_release(pgds_tableoid_array[index]);
+		pgds_count(PGDS_STAT_GOVERNOR_DEFERRED, 1);
+		pgds_analyze_queue(index, true, false);
+		return;
+	}
+
+    if (strcmp(count_val, "0") == 0) 
+	{
+		instr_time start;
+		uint64 us;
+
+		pgds_governor_charge(pgds_tableoid_array[index]);
+		initStringInfo(&buf_analyze);
+		appendStringInfo(&buf_analyze, "analyze verbose %s;", pgds_tablename_array[index]);
+		elog(DEBUG1,"pgds: pgds_analyze_table: analyze: %s", pgds_tablename_array[index]);
+		pgds_count(PGDS_STAT_ANALYZE_SYNC, 1);
+		TRACE_PGDS_ANALYZE_START(pgds_tableoid_array[index]);
+		INSTR_TIME_SET_CURRENT(start);
+		pgstat_report_wait_start(pgds_we_inline_analyze);
+		ret = SPI_execute(buf_analyze.data, false, 0);
+		pgstat_report_wait_end();
+		if (ret != SPI_OK_UTILITY)
+			elog(ERROR, "cannot run analyze for %s: error code %d", pgds_tablename_array[index], ret);
+		pgds_governor_release();
+		us = pgds_phase_record(PGDS_PHASE_ANALYZE, start);
+		TRACE_PGDS_ANALYZE_DONE(pgds_tableoid_array[index], us);
+		pgds_relstat_report(pgds_tableoid_array[index], 1, 1, 0, 1,
+				    us / 1000.0,
+				    pgds_rows_sampled(pgds_tableoid_array[index]));
+		pgds_event(PGDS_EVENT_ANALYZE, pgds_tableoid_array[index], us, true);
+		pgds_explain_record(pgds_tableoid_array[index], PGDS_EVENT_ANALYZE, us);
+		elog(LOG, "pgds: analyze %s: %.3f ms", pgds_tablename_array[index], us / 1000.0);
+	}
+	else if (!RecoveryInProgress() && pgds_provisional_lookup(pgds_tableoid_array[index]))
+	{
+		/*
+		 * quick statistics only: ANALYZE may not have been queued, may have
+		 * failed or may have been lost by a restart
+		 */
+		if (!pgds_inflight_busy(pgds_tableoid_array[index]))
+			pgds_analyze_queue(index, false, true);
+		else
+			pgds_relstat_report(pgds_tableoid_array[index], 1, 0, 1, 0, 0, 0);
+	}
+	else
+	{
+		pgds_stats_cache_insert(pgds_tableoid_array[index]);
+		pgds_count(PGDS_STAT_SKIP_HAS_STATS, 1);
+		pgds_relstat_report(pgds_tableoid_array[index], 1, 0, 0, 0, 0, 0);
+		pgds_event(PGDS_EVENT_HAS_STATS, pgds_tableoid_array[index], 0, false);
+	}
+}
+
+/*
+ * pgds_brin_unsummarized
+ *
+ * number of unsummarized ranges at the end of the table of BRIN index,
+ * counting stops at pgds.brin_summarize_ranges or at first range
+ */
+static int pgds_brin_unsummarized(Relation idxrel, BlockNumber nblocks, BlockNumber *pages_per_range)
+{
+	BrinRevmap *revmap;
+	BlockNumber heap_blk;
+	Buffer	buf = InvalidBuffer;
+	int	n = 0;
+
+#if PG_VERSION_NUM >= 170000
+	revmap = brinRevmapInitialize(idxrel, pages_per_range);
+#else
+	revmap = brinRevmapInitialize(idxrel, pages_per_range, NULL);
+#endif
+	if (nblocks == 0)
+	{
+		brinRevmapTerminate(revmap);
+		return 0;
+	}
+
+	heap_blk = ((nblocks - 1) / *pages_per_range) * *pages_per_range;
+	for (;;)
+	{
+		BrinTuple  *tup;
+		OffsetNumber off;
+		Size	size;
+
+		CHECK_FOR_INTERRUPTS();
+#if PG_VERSION_NUM >= 170000
+		tup = brinGetTupleForHeapBlock(revmap, heap_blk, &buf, &off, &size, BUFFER_LOCK_SHARE);
+#else
+		tup = brinGetTupleForHeapBlock(revmap, heap_blk, &buf, &off, &size, BUFFER_LOCK_SHARE, NULL);
+#endif
+		if (tup != NULL)
+		{
+			LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+			break;
+		}
+		if (++n >= pgds_brin_summarize_ranges || heap_blk == 0)
+			break;
+		heap_blk -= *pages_per_range;
+	}
+
+	if (BufferIsValid(buf))
+		ReleaseBuffer(buf);
+	brinRevmapTerminate(revmap);
+
+	return n;
+}
+
+/*
+ * pgds_gin_pending
+ *
+ * number of pages of GIN index pending list, read from metapage
+ */
+static BlockNumber pgds_gin_pending(Relation idxrel)
+{
+	Buffer	buf;
+	BlockNumber npending;
+
+	buf = ReadBuffer(idxrel, GIN_METAPAGE_BLKNO);
+	LockBuffer(buf, GIN_SHARE);
+	npending = GinPageGetMeta(BufferGetPage(buf))->nPendingPages;
+	UnlockReleaseBuffer(buf);
+
+	return npending;
+}
+
+/*
+ * pgds_index_queue
+ */
+static void pgds_index_queue(pgdsWorkKind kind, Oid indexoid)
+{
+	pgdsWorkItem item;
+
+	memset(&item, 0, sizeof(item));
+	item.kind = kind;
+	item.dboid = MyDatabaseId;
+	item.userid = GetUserId();
+	item.relid = indexoid;
+	if (pgds_enqueue_work(&item))
+	{
+		pgds_async_pending = true;
+		pgds_count(kind == PGDS_WORK_BRIN_SUMMARIZE ? PGDS_STAT_BRIN_QUEUED : PGDS_STAT_GIN_QUEUED, 1);
+	}
+	else
+		elog(DEBUG1, "pgds: work queue is full: index %u not queued", indexoid);
+}
+
+/*
+ * pgds_index_check
+ *
+ * queue summarization of BRIN indexes of table ending with at least
+ * pgds.brin_summarize_ranges unsummarized ranges and cleanup of GIN
+ * indexes having at least pgds.gin_pending_pages pending pages.
+ * A BRIN index is checked again only once table has grown by one range,
+ * a table without BRIN or GIN index is not checked again until its relcache
+ * entry is invalidated.
+ */
+static void pgds_index_check(int index)
+{
+	Oid	relid = pgds_tableoid_array[index];
+	Relation rel;
+	List	*indexes;
+	ListCell *lc;
+	BlockNumber nblocks;
+	bool	has_brin = false;
+	bool	has_gin = false;
+
+	if (!superuser() && GetUserId() != pgds_tableowner_array[index])
+		return;
+	if (pgds_noindex_cache != NULL &&
+	    hash_search(pgds_noindex_cache, &relid, HASH_FIND, NULL) != NULL)
+		return;
+
+	rel = try_relation_open(relid, AccessShareLock);
+	if (rel == NULL)
+		return;
+	if (rel->rd_rel->relkind != RELKIND_RELATION && rel->rd_rel->relkind != RELKIND_MATVIEW)
+	{
+		relation_close(rel, AccessShareLock);
+		return;
+	}
+
+	indexes = RelationGetIndexList(rel);
+	foreach(lc, indexes)
+	{
+		Relation idxrel = index_open(lfirst_oid(lc), AccessShareLock);
+		Oid	relam = idxrel->rd_rel->relam;
+
+		index_close(idxrel, AccessShareLock);
+		if (relam == BRIN_AM_OID)
+			has_brin = true;
+		else if (relam == GIN_AM_OID)
+			has_gin = true;
+	}
+	if (!has_brin && !has_gin)
+	{
+		/* forgotten by relcache invalidation of table, sent by CREATE INDEX */
+		if (pgds_noindex_cache == NULL)
+		{
+			HASHCTL ctl;
+
+			memset(&ctl, 0, sizeof(ctl));
+			ctl.keysize = sizeof(Oid);
+			ctl.entrysize = sizeof(Oid);
+			ctl.hcxt = TopMemoryContext;
+			pgds_noindex_cache = hash_create("pgds no index cache", 64, &ctl,
+							 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+		}
+		(void) hash_search(pgds_noindex_cache, &relid, HASH_ENTER, NULL);
+		list_free(indexes);
+		relation_close(rel, AccessShareLock);
+		return;
+	}
+
+	nblocks = (has_brin && pgds_brin_summarize_ranges > 0) ? RelationGetNumberOfBlocks(rel) : 0;
+	foreach(lc, indexes)
+	{
+		Oid	indexoid = lfirst_oid(lc);
+		Relation idxrel;
+		pgdsIndexChecked *checked;
+		Oid	relam;
+		int	unsummarized = 0;
+		BlockNumber pages_per_range = 0;
+		BlockNumber npending = 0;
+
+		if (pgds_index_cache != NULL)
+		{
+			checked = (pgdsIndexChecked *) hash_search(pgds_index_cache, &indexoid, HASH_FIND, NULL);
+			if (checked != NULL &&
+			    (checked->relam == GIN_AM_OID ? pgds_gin_pending_pages == 0 :
+			     (checked->relam != BRIN_AM_OID || pgds_brin_summarize_ranges == 0 ||
+			      nblocks < checked->nblocks + checked->pages_per_range)))
+				continue;
+		}
+
+		/* opening index may process invalidations: cache is updated afterwards */
+		idxrel = index_open(indexoid, AccessShareLock);
+		relam = idxrel->rd_rel->relam;
+		if (relam == BRIN_AM_OID && pgds_brin_summarize_ranges > 0)
+			unsummarized = pgds_brin_unsummarized(idxrel, nblocks, &pages_per_range);
+		else if (relam == GIN_AM_OID && pgds_gin_pending_pages > 0)
+			npending = pgds_gin_pending(idxrel);
+		index_close(idxrel, AccessShareLock);
+
+		if (pgds_index_cache == NULL)
+		{
+			HASHCTL ctl;
+
+			memset(&ctl, 0, sizeof(ctl));
+			ctl.keysize = sizeof(Oid);
+			ctl.entrysize = sizeof(pgdsIndexChecked);
+			ctl.hcxt = TopMemoryContext;
+			pgds_index_cache = hash_create("pgds index cache", 64, &ctl,
+						       HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+		}
+		checked = (pgdsIndexChecked *) hash_search(pgds_index_cache, &indexoid, HASH_ENTER, NULL);
+		checked->relam = relam;
+		checked->nblocks = nblocks;
+		checked->pages_per_range = pages_per_range;
+
+		if (relam == BRIN_AM_OID && pgds_brin_summarize_ranges > 0)
+		{
+			elog(DEBUG1, "pgds: BRIN index %u: %d unsummarized ranges", indexoid, unsummarized);
+			/* a table with fewer ranges than the threshold has all of them unsummarized */
+			if (unsummarized > 0 &&
+			    unsummarized >= Min(pgds_brin_summarize_ranges,
+						(int) ((nblocks - 1) / pages_per_range + 1)))
+				pgds_index_queue(PGDS_WORK_BRIN_SUMMARIZE, indexoid);
+		}
+		else if (relam == GIN_AM_OID && pgds_gin_pending_pages > 0)
+		{
+			elog(DEBUG1, "pgds: GIN index %u: %u pending pages", indexoid, npending);
+			if (npending >= (BlockNumber) pgds_gin_pending_pages)
+				pgds_index_queue(PGDS_WORK_GIN_CLEAN, indexoid);
+		}
+	}
+	list_free(indexes);
+	relation_close(rel, AccessShareLock);
+}
+
+/*
+ * pgds_index_clean
+ *
+ * run brin_summarize_new_values or gin_clean_pending_list with SPI:
+ * caller must be connected to SPI
+ */
+static void pgds_index_clean(pgdsWorkItem *item)
+{
+	StringInfoData buf;
+	const char *function;
+	char	*qualname;
+	char	*count;
+	int	ret;
+	instr_time start;
+	instr_time duration;
+
+	qualname = pgds_qualified_name(item->relid);
+	if (qualname == NULL)
+		return;
+
+	function = (item->kind == PGDS_WORK_BRIN_SUMMARIZE) ? "brin_summarize_new_values" : "gin_clean_pending_list";
+	initStringInfo(&buf);
+	appendStringInfo(&buf, "select %s(%s::regclass)", function, quote_literal_cstr(qualname));
+	INSTR_TIME_SET_CURRENT(start);
+	ret = SPI_execute(buf.data, false, 1);
+	if (ret != SPI_OK_SELECT)
+		elog(ERROR, "pgds: cannot run %s: error code %d", buf.data, ret);
+	count = SPI_getvalue(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1);
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	pgds_event(item->kind == PGDS_WORK_BRIN_SUMMARIZE ? PGDS_EVENT_BRIN_SUMMARIZE : PGDS_EVENT_GIN_CLEAN,
+		   item->relid, INSTR_TIME_GET_MICROSEC(duration), true);
+	elog(LOG, "pgds: %s(%s): %s %s, %.3f ms", function, qualname, count,
+	     (item->kind == PGDS_WORK_BRIN_SUMMARIZE) ? "ranges" : "pages",
+	     INSTR_TIME_GET_MILLISEC(duration));
+}
+
+/*
+ * pgds_vacuum_claim
+ *
+ * returns false if relid has been considered for VACUUM by any backend
+ * during the last PGDS_VACUUM_REQUEUE_MS, else remembers it in place of
+ * the oldest entry
+ */
+static bool pgds_vacuum_claim(Oid relid)
+{
+	TimestampTz now = GetCurrentTimestamp();
+	pgdsVacuumQueued *oldest = NULL;
+	int	i;
+
+	if (pgds == NULL)
+		return false;
+
+	LWLockAcquire(pgds->lock, LW_EXCLUSIVE);
+	for (i = 0; i < PGDS_VACUUM_QUEUED; i++)
+	{
+		pgdsVacuumQueued *q = &pgds->vacuum_queued[i];
+
+		if (q->dboid == MyDatabaseId && q->relid == relid)
+		{
+			if (!TimestampDifferenceExceeds(q->queued_at, now, PGDS_VACUUM_REQUEUE_MS))
+			{
+				LWLockRelease(pgds->lock);
+				return false;
+			}
+			oldest = q;
+			break;
+		}
+		if (oldest == NULL || q->queued_at < oldest->queued_at)
+			oldest = q;
+	}
+	oldest->dboid = MyDatabaseId;
+	oldest->relid = relid;
+	oldest->queued_at = now;
+	LWLockRelease(pgds->lock);
+
+	return true;
+}
+
+/*
+ * pgds_vacuum_claimed
+ *
+ * returns true if relid has been considered for VACUUM by any backend
+ * during the last PGDS_VACUUM_REQUEUE_MS
+ */
+static bool pgds_vacuum_claimed(Oid relid)
+{
+	TimestampTz now = GetCurrentTimestamp();
+	bool	claimed = false;
+	int	i;
+
+	LWLockAcquire(pgds->lock, LW_SHARED);
+	for (i = 0; i < PGDS_VACUUM_QUEUED; i++)
+	{
+		pgdsVacuumQueued *q = &pgds->vacuum_queued[i];
+
+		if (q->dboid == MyDatabaseId && q->relid == relid)
+		{
+			claimed = !TimestampDifferenceExceeds(q->queued_at, now, PGDS_VACUUM_REQUEUE_MS);
+			break;
+		}
+	}
+	LWLockRelease(pgds->lock);
+
+	return claimed;
+}
+
+/*
+ * pgds_vacuum_check
+ *
+ * queue VACUUM of table having few all-visible pages and an index able to
+ * return tuples: index-only scans of this table would fetch heap pages.
+ * All-visible pages are counted in the visibility map, which a VACUUM
+ * that has just run has already set.
+ */
+static void pgds_vacuum_check(int index)
+{
+	Oid	relid = pgds_tableoid_array[index];
+	Relation rel;
+	BlockNumber nblocks;
+	BlockNumber allvisible;
+	List	*indexes;
+	ListCell *lc;
+	bool	can_return = false;
+
+	if (!superuser() && GetUserId() != pgds_tableowner_array[index])
+		return;
+	if (pgds == NULL || pgds_vacuum_claimed(relid))
+		return;
+
+	rel = try_relation_open(relid, AccessShareLock);
+	if (rel == NULL)
+		return;
+	if ((rel->rd_rel->relkind != RELKIND_RELATION && rel->rd_rel->relkind != RELKIND_MATVIEW) ||
+	    !rel->rd_rel->relhasindex)
+	{
+		relation_close(rel, AccessShareLock);
+		return;
+	}
+
+	nblocks = RelationGetNumberOfBlocks(rel);
+	if (nblocks < PGDS_VACUUM_MIN_PAGES)
+	{
+		relation_close(rel, AccessShareLock);
+		return;
+	}
+	visibilitymap_count(rel, &allvisible, NULL);
+	if (allvisible >= pgds_vacuum_visible_fraction * nblocks)
+	{
+		relation_close(rel, AccessShareLock);
+		return;
+	}
+
+	indexes = RelationGetIndexList(rel);
+	foreach(lc, indexes)
+	{
+		Relation idxrel = index_open(lfirst_oid(lc), AccessShareLock);
+
+		can_return = (idxrel->rd_indam->amcanreturn != NULL);
+		index_close(idxrel, AccessShareLock);
+		if (can_return)
+			break;
+	}
+	list_free(indexes);
+	relation_close(rel, AccessShareLock);
+
+	if (!can_return || !pgds_vacuum_claim(relid))
+		return;
+
+	elog(DEBUG1, "pgds: %s: %u all-visible pages of %u", pgds_tablename_array[index], allvisible, nblocks);
+	{
+		pgdsWorkItem item;
+
+		memset(&item, 0, sizeof(item));
+		item.kind = PGDS_WORK_VACUUM;
+		item.dboid = MyDatabaseId;
+		item.userid = GetUserId();
+		item.relid = relid;
+		if (!pgds_enqueue_work(&item))
+		{
+			elog(DEBUG1, "pgds: work queue is full: vacuum of %s not queued", pgds_tablename_array[index]);
+			return;
+		}
+	}
+	pgds_async_pending = true;
+	pgds_count(PGDS_STAT_VACUUM_QUEUED, 1);
+}
+
+/*
+ * pgds_vacuum
+ *
+ * run VACUUM of work item in background worker: VACUUM manages its own
+ * transactions and cannot be run with SPI
+ */
+static void pgds_vacuum(pgdsWorkItem *item)
+{
+	MemoryContext oldcxt;
+	char	*qualname;
+	char	*command;
+	List	*parsetree;
+	ParseState *pstate;
+	instr_time start;
+	instr_time duration;
+
+	MemoryContextReset(pgds_vacuum_context);
+	PortalContext = pgds_vacuum_context;
+
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+
+	/* parse tree must survive transactions committed by VACUUM */
+	oldcxt = MemoryContextSwitchTo(pgds_vacuum_context);
+	qualname = pgds_qualified_name(item->relid);
+	if (qualname == NULL)
+	{
+		MemoryContextSwitchTo(oldcxt);
+		CommitTransactionCommand();
+		return;
+	}
+	command = psprintf("vacuum (skip_locked) %s", qualname);
+#if PG_VERSION_NUM >= 140000
+	parsetree = raw_parser(command, RAW_PARSE_DEFAULT);
+#else
+	parsetree = raw_parser(command);
+#endif
+	pstate = make_parsestate(NULL);
+	pstate->p_sourcetext = command;
+	MemoryContextSwitchTo(oldcxt);
+
+	pgstat_report_activity(STATE_RUNNING, command);
+	INSTR_TIME_SET_CURRENT(start);
+	ExecVacuum(pstate, (VacuumStmt *) linitial_node(RawStmt, parsetree)->stmt, true);
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	CommitTransactionCommand();
+	pgstat_report_activity(STATE_IDLE, NULL);
+
+	pgds_event(PGDS_EVENT_VACUUM, item->relid, INSTR_TIME_GET_MICROSEC(duration), true);
+	elog(LOG, "pgds: %s: %.3f ms", command, INSTR_TIME_GET_MILLISEC(duration));
+}
+
+/*
+ * pgds_explain_record
+ *
+ * remember action taken for relid by current statement: last action
+ * is kept and durations are added
+ */
+static void pgds_explain_record(Oid relid, pgdsEventAction action, uint64 duration_us)
+{
+	int i;
+
+	for (i = 0; i < pgds_explain_nrels; i++)
+	{
+		if (pgds_explain_rels[i].relid == relid)
+		{
+			pgds_explain_rels[i].action = action;
+			pgds_explain_rels[i].duration_us += duration_us;
+			return;
+		}
+	}
+	if (pgds_explain_nrels >= MAX_TABLE)
+		return;
+
+	pgds_explain_rels[pgds_explain_nrels].relid = relid;
+	pgds_explain_rels[pgds_explain_nrels].action = action;
+	pgds_explain_rels[pgds_explain_nrels].duration_us = duration_us;
+	pgds_explain_nrels++;
+}
+
+#if PG_VERSION_NUM >= 130000
+/*
+ * pgds_last_analyze_time
+ *
+ * returns time of last manual or automatic analyze of relid, 0 if unknown
+ */
+static TimestampTz pgds_last_analyze_time(Oid relid)
+{
+	PgStat_StatTabEntry *tabentry;
+
+	tabentry = pgstat_fetch_stat_tabentry(relid);
+	if (tabentry == NULL)
+		return 0;
+
+#if PG_VERSION_NUM >= 160000
+	return Max(tabentry->last_analyze_time, tabentry->last_autoanalyze_time);
+#else
+	return Max(tabentry->analyze_timestamp, tabentry->autovac_analyze_timestamp);
+#endif
+}
+
+/*
+ * pgds_explain_section
+ *
+ * add pgds section with action, time spent and statistics age of each
+ * relation checked by last statement
+ */
+static void pgds_explain_section(ExplainState *es)
+{
+	int i;
+
+	ExplainOpenGroup("pgds", "pgds", false, es);
+	if (es->format == EXPLAIN_FORMAT_TEXT)
+	{
+		appendStringInfoSpaces(es->str, es->indent * 2);
+		appendStringInfoString(es->str, "pgds:\n");
+		es->indent++;
+	}
+
+	for (i = 0; i < pgds_explain_nrels; i++)
+	{
+		pgdsExplainRel *rel = &pgds_explain_rels[i];
+		char	   *relname;
+		TimestampTz	last_analyze;
+		const char *action;
+
+		relname = pgds_qualified_name(rel->relid);
+		if (relname == NULL)
+			continue;
+
+		switch (rel->action)
+		{
+			case PGDS_EVENT_ANALYZE:
+				action = "analyzed";
+				break;
+			case PGDS_EVENT_ANALYZE_WAIT:
+				action = "waited for concurrent analyze";
+				break;
+			case PGDS_EVENT_NOT_OWNER:
+				action = "skipped: not owner";
+				break;
+			case PGDS_EVENT_QUEUED:
+				action = "queued";
+				break;
+			case PGDS_EVENT_STANDBY_DEMAND:
+				action = "requested from primary";
+				break;
+			case PGDS_EVENT_QUICK_STATS:
+				action = "quick statistics, analyze queued";
+				break;
+			default:
+				action = "skipped: has statistics";
+				break;
+		}
+
+		ExplainOpenGroup("Relation", NULL, true, es);
+		ExplainPropertyText("Relation", relname, es);
+		ExplainPropertyText("Action", action, es);
+		ExplainPropertyFloat("Time", "ms", rel->duration_us / 1000.0, 3, es);
+
+		/* statistics of relation analyzed by this statement have just been built */
+		last_analyze = (rel->action == PGDS_EVENT_ANALYZE) ? GetCurrentTimestamp()
+								   : pgds_last_analyze_time(rel->relid);
+		if (last_analyze != 0)
+		{
+			long	secs;
+			int	usecs;
+
+			TimestampDifference(last_analyze, GetCurrentTimestamp(), &secs, &usecs);
+			ExplainPropertyInteger("Statistics Age", "s", secs, es);
+		}
+		else
+			ExplainPropertyText("Statistics Age", "unknown", es);
+		ExplainCloseGroup("Relation", NULL, true, es);
+	}
+
+	if (es->format == EXPLAIN_FORMAT_TEXT)
+		es->indent--;
+	ExplainCloseGroup("pgds", "pgds", false, es);
+}
+#endif
+
+#if PG_VERSION_NUM >= 180000
+/*
+ * pgds_explain_option
+ *
+ * EXPLAIN (PGDS) option handler
+ */
+static void pgds_explain_option(ExplainState *es, DefElem *opt, ParseState *pstate)
+{
+	bool *enabled = palloc(sizeof(bool));
+
+	*enabled = defGetBoolean(opt);
+	SetExplainExtensionState(es, pgds_explain_id, enabled);
+}
+
+/*
+ * pgds_explain_per_plan
+ */
+static void pgds_explain_per_plan(PlannedStmt *plannedstmt, IntoClause *into, ExplainState *es,
+				  const char *queryString, ParamListInfo params,
+				  QueryEnvironment *queryEnv)
+{
+	bool *enabled;
+
+	if (prev_explain_per_plan_hook)
+		prev_explain_per_plan_hook(plannedstmt, into, es, queryString, params, queryEnv);
+
+	enabled = GetExplainExtensionState(es, pgds_explain_id);
+	if (enabled != NULL ? *enabled : pgds_explain)
+		pgds_explain_section(es);
+}
+#elif PG_VERSION_NUM >= 130000
+/*
+ * pgds_ExplainOneQuery
+ *
+ * ExplainOnePlan closes query group before returning: pgds section is
+ * only added in text format. Before PostgreSQL 17 the hook replaces
+ * planning of ExplainOneQuery, which is done here the same way.
+ */
+static void pgds_ExplainOneQuery(Query *query, int cursorOptions, IntoClause *into,
+				 ExplainState *es, const char *queryString,
+				 ParamListInfo params, QueryEnvironment *queryEnv)
+{
+	if (prev_ExplainOneQuery_hook)
+		prev_ExplainOneQuery_hook(query, cursorOptions, into, es, queryString, params, queryEnv);
+	else
+	{
+#if PG_VERSION_NUM >= 170000
+		standard_ExplainOneQuery(query, cursorOptions, into, es, queryString, params, queryEnv);
+#else
+		PlannedStmt *plan;
+		instr_time	planstart;
+		instr_time	planduration;
+		BufferUsage	bufusage_start;
+		BufferUsage	bufusage;
+
+		if (es->buffers)
+			bufusage_start = pgBufferUsage;
+		INSTR_TIME_SET_CURRENT(planstart);
+		plan = pg_plan_query(query, queryString, cursorOptions, params);
+		INSTR_TIME_SET_CURRENT(planduration);
+		INSTR_TIME_SUBTRACT(planduration, planstart);
+		if (es->buffers)
+		{
+			memset(&bufusage, 0, sizeof(BufferUsage));
+			BufferUsageAccumDiff(&bufusage, &pgBufferUsage, &bufusage_start);
+		}
+		ExplainOnePlan(plan, into, es, queryString, params, queryEnv,
+			       &planduration, (es->buffers ? &bufusage : NULL));
+#endif
+	}
+
+	if (pgds_explain && es->format == EXPLAIN_FORMAT_TEXT && pgds_explain_nrels > 0)
+		pgds_explain_section(es);
+}
+#endif
+
+/*
+ * pgds_qualified_name
+ *
+ * returns quoted schema qualified name of relid or NULL if relation has been dropped
+ */
+static char *pgds_qualified_name(Oid relid)
+{
+	char *relname;
+	char *nspname;
+
+	relname = get_rel_name(relid);
+	if (relname == NULL)
+		return NULL;
+	nspname = get_namespace_name(get_rel_namespace(relid));
+	if (nspname == NULL)
+		return NULL;
+
+	return quote_qualified_identifier(nspname, relname);
+}
+
+/*
+ * pgds_rel_owner
+ */
+static Oid pgds_rel_owner(Oid relid)
+{
+	HeapTuple	tp;
+	Oid		relowner = InvalidOid;
+
+	tp = SearchSysCache1(RELOID, ObjectIdGetDatum(relid));
+	if (HeapTupleIsValid(tp))
+	{
+		relowner = ((Form_pg_class) GETSTRUCT(tp))->relowner;
+		ReleaseSysCache(tp);
+	}
+
+	return relowner;
+}
+
+/*
+ * pgds_analyze_command
+ *
+ * builds ANALYZE statement for relid restricted to attnums if natts > 0
+ */
+static char *pgds_analyze_command(Oid relid, int natts, const int16 *attnums)
+{
+	StringInfoData buf;
+	char *qualname;
+	int i;
+
+	qualname = pgds_qualified_name(relid);
+	if (qualname == NULL)
+		return NULL;
+
+	initStringInfo(&buf);
+	appendStringInfo(&buf, "analyze %s", qualname);
+	if (natts > 0)
+	{
+		appendStringInfoChar(&buf, '(');
+		for (i = 0; i < natts; i++)
+		{
+			if (i > 0)
+				appendStringInfoString(&buf, ", ");
+			appendStringInfoString(&buf, quote_identifier(get_attname(relid, attnums[i], false)));
+		}
+		appendStringInfoChar(&buf, ')');
+	}
+
+	return buf.data;
+}
+
+/*
+ * pgds_init_srf
+ *
+ * set up materialize mode for a set returning function
+ */
+static Tuplestorestate *pgds_init_srf(FunctionCallInfo fcinfo, TupleDesc *tupdesc)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	Tuplestorestate *tupstore;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		elog(ERROR, "pgds: set-valued function called in context that cannot accept a set");
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		elog(ERROR, "pgds: materialize mode required, but it is not allowed in this context");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	if (get_call_result_type(fcinfo, NULL, tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "pgds: return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = *tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return tupstore;
+}
+
+/*
+ * pgds_enqueue_work
+ *
+ * add work item to shared queue: returns false if queue is full.
+ * Pending items for the same relation are merged.
+ */
+static bool pgds_enqueue_work(pgdsWorkItem *item)
+{
+	pgdsWorkItem *free_item = NULL;
+	int i;
+	int j;
+	int k;
+
+	LWLockAcquire(pgds->lock, LW_EXCLUSIVE);
+
+	for (i = 0; i < MAX_WORK_ITEMS; i++)
+	{
+		pgdsWorkItem *w = &pgds->work[i];
+
+		if (w->kind == PGDS_WORK_FREE)
+		{
+			if (free_item == NULL)
+				free_item = w;
+			continue;
+		}
+		if (w->kind == item->kind && w->dboid == item->dboid &&
+		    w->userid == item->userid && w->relid == item->relid)
+		{
+			if (w->natts == 0 || item->natts == 0)
+				w->natts = 0;
+			else
+			{
+				for (j = 0; j < item->natts; j++)
+				{
+					for (k = 0; k < w->natts; k++)
+						if (w->attnums[k] == item->attnums[j])
+							break;
+					if (k < w->natts)
+						continue;
+					if (w->natts == MAX_WORK_ATTS)
+					{
+						w->natts = 0;
+						break;
+					}
+					w->attnums[w->natts++] = item->attnums[j];
+				}
+			}
+			LWLockRelease(pgds->lock);
+			return true;
+		}
+	}
+
+	if (free_item != NULL)
+		memcpy(free_item, item, sizeof(pgdsWorkItem));
+
+	LWLockRelease(pgds->lock);
+
+	return (free_item != NULL);
+}
+
+/*
+ * pgds_drainer_release
+ *
+ * free drainer slot of this worker: caller must hold pgds->lock exclusively
+ */
+static void pgds_drainer_release(void)
+{
+	int i;
+
+	for (i = 0; i < PGDS_DRAINERS; i++)
+		if (pgds->drainers[i].pid == MyProcPid)
+			memset(&pgds->drainers[i], 0, sizeof(pgdsDrainer));
+}
+
+/*
+ * pgds_drainer_exit
+ *
+ * free drainer slot of a worker exiting on error
+ */
+static void pgds_drainer_exit(int code, Datum arg)
+{
+	bool held = LWLockHeldByMe(pgds->lock);
+
+	if (!pgds_is_drainer)
+		return;
+
+	if (!held)
+		LWLockAcquire(pgds->lock, LW_EXCLUSIVE);
+	pgds_drainer_release();
+	if (!held)
+		LWLockRelease(pgds->lock);
+	pgds_is_drainer = false;
+}
+
+/*
+ * pgds_dequeue_work
+ *
+ * remove first work item for dboid and userid from shared queue: only
+ * ANALYZE items if analyze_only
+ */
+static bool pgds_dequeue_work(Oid dboid, Oid userid, bool analyze_only, pgdsWorkItem *item)
+{
+	bool found = false;
+	int i;
+
+	LWLockAcquire(pgds->lock, LW_EXCLUSIVE);
+
+	for (i = 0; i < MAX_WORK_ITEMS; i++)
+	{
+		pgdsWorkItem *w = &pgds->work[i];
+
+		if (w->kind != PGDS_WORK_FREE && w->dboid == dboid && w->userid == userid &&
+		    (!analyze_only || w->kind == PGDS_WORK_ANALYZE || w->kind == PGDS_WORK_ANALYZE_MISSING))
+		{
+			memcpy(item, w, sizeof(pgdsWorkItem));
+			w->kind = PGDS_WORK_FREE;
+			found = true;
+			break;
+		}
+	}
+
+	/* queue is empty: items queued from now on launch a new drainer */
+	if (!found && pgds_is_drainer)
+	{
+		pgds_drainer_release();
+		pgds_is_drainer = false;
+	}
+
+	LWLockRelease(pgds->lock);
+
+	return found;
+}
+
+/*
+ * pgds_execute_work_item
+ *
+ * run work item with SPI: caller must be connected to SPI
+ */
+static void pgds_execute_work_item(pgdsWorkItem *item)
+{
+	char *command;
+	int ret;
+	instr_time start;
+	uint64 us;
+
+	if (item->kind == PGDS_WORK_BRIN_SUMMARIZE || item->kind == PGDS_WORK_GIN_CLEAN)
+	{
+		pgds_index_clean(item);
+		return;
+	}
+
+	if (item->kind == PGDS_WORK_ANALYZE_MISSING)
+	{
+		StringInfoData buf;
+
+		/*
+		 * another process is analyzing relation: claim is held until
+		 * commit so that statements do not queue it again meanwhile
+		 */
+		if (!pgds_inflight_claim(item->relid))
+			return;
+
+		/* statistics may have been built since item was queued: probe with a new snapshot */
+		initStringInfo(&buf);
+		appendStringInfo(&buf, "select 1 where (%s) > 0", pgds_stats_probe_query(item->relid));
+		pgds_count(PGDS_STAT_CATALOG_PROBES, 1);
+		ret = SPI_execute(buf.data, false, 1);
+		if (ret != SPI_OK_SELECT)
+			elog(ERROR, "pgds: cannot select from pg_statistic for relid %u: error code %d", item->relid, ret);
+		if (SPI_processed > 0)
+			return;
+	}
+
+	command = pgds_analyze_command(item->relid, item->natts, item->attnums);
+	if (command == NULL)
+		return;
+
+	/* ANALYZE samples 300 rows per statistics target unit */
+	if (get_rel_relkind(item->relid) == RELKIND_FOREIGN_TABLE)
+	{
+		char target[16];
+
+		snprintf(target, sizeof(target), "%d",
+			 Min(Max((pgds_foreign_sample_rows + 299) / 300, 1), 10000));
+		(void) set_config_option("default_statistics_target", target,
+					 PGC_USERSET, PGC_S_SESSION, GUC_ACTION_LOCAL,
+					 true, 0, false);
+	}
+
+	pgds_init_wait_events();
+	pgds_governor_charge(item->relid);
+
+	TRACE_PGDS_ANALYZE_START(item->relid);
+	INSTR_TIME_SET_CURRENT(start);
+	pgstat_report_wait_start(pgds_we_inline_analyze);
+	ret = SPI_execute(command, false, 0);
+	pgstat_report_wait_end();
+	us = pgds_phase_record(PGDS_PHASE_ANALYZE, start);
+	TRACE_PGDS_ANALYZE_DONE(item->relid, us);
+	if (ret != SPI_OK_UTILITY)
+	{
+		elog(WARNING, "pgds: cannot run %s: error code %d", command, ret);
+		pgds_count(PGDS_STAT_ERRORS, 1);
+		pgds_breaker_failure(item->relid);
+		pgds_event(PGDS_EVENT_ANALYZE_FAILED, item->relid, us, true);
+		return;
+	}
+	pgds_count(IsBackgroundWorker ? PGDS_STAT_ANALYZE_ASYNC : PGDS_STAT_ANALYZE_SYNC, 1);
+	pgds_event(PGDS_EVENT_ANALYZE, item->relid, us, true);
+	elog(LOG, "pgds: %s: %.3f ms", command, us / 1000.0);
+	pgds_relstat_report(item->relid, 0, 0, 0, 1, us / 1000.0,
+			    pgds_rows_sampled(item->relid));
+	pgds_provisional_clear(item->relid);
+}
+
+/*
+ * pgds_prewarm_execute
+ *
+ * run work item in backend calling pgds_prewarm_from_statements once
+ * governor admits it
+ */
+static void pgds_prewarm_execute(pgdsWorkItem *item)
+{
+	if (pgds != NULL && !pgds_governor_wait(item->relid, true))
+	{
+		/* not admitted in time: left to a worker */
+		if (pgds_enqueue_work(item))
+			pgds_launch_drainer(MyDatabaseId, GetUserId());
+		return;
+	}
+	pgds_execute_work_item(item);
+	pgds_governor_release();
+}
+
+/*
+ * pgds_launch_workers
+ *
+ * start background workers draining the work queue for current database and user
+ */
+static int pgds_launch_workers(int nworkers, BackgroundWorkerHandle **handles)
+{
+	return pgds_launch_workers_for(MyDatabaseId, GetUserId(), nworkers, handles, false);
+}
+
+/*
+ * pgds_launch_drainer
+ *
+ * start a background worker draining the work queue for dboid and userid
+ * unless one is already running
+ */
+static void pgds_launch_drainer(Oid dboid, Oid userid)
+{
+	BackgroundWorkerHandle *handle;
+	TimestampTz	now = GetCurrentTimestamp();
+	int		free_slot = -1;
+	int		i;
+
+	LWLockAcquire(pgds->lock, LW_EXCLUSIVE);
+	for (i = 0; i < PGDS_DRAINERS; i++)
+	{
+		pgdsDrainer *d = &pgds->drainers[i];
+
+		/* postmaster could not start worker */
+		if (d->dboid != InvalidOid && d->pid == 0 &&
+		    TimestampDifferenceExceeds(d->launched, now, PGDS_DRAINER_START_TIMEOUT))
+			memset(d, 0, sizeof(pgdsDrainer));
+		if (d->dboid == dboid && d->userid == userid)
+		{
+			LWLockRelease(pgds->lock);
+			return;
+		}
+		if (d->dboid == InvalidOid && free_slot < 0)
+			free_slot = i;
+	}
+	if (free_slot < 0)
+	{
+		LWLockRelease(pgds->lock);
+		elog(LOG, "pgds: too many background workers draining the work queue: queued items of database %u wait",
+		     dboid);
+		return;
+	}
+	pgds->drainers[free_slot].dboid = dboid;
+	pgds->drainers[free_slot].userid = userid;
+	pgds->drainers[free_slot].pid = 0;
+	pgds->drainers[free_slot].launched = now;
+	LWLockRelease(pgds->lock);
+
+	if (pgds_launch_workers_for(dboid, userid, 1, &handle, true) == 0)
+	{
+		LWLockAcquire(pgds->lock, LW_EXCLUSIVE);
+		if (pgds->drainers[free_slot].dboid == dboid && pgds->drainers[free_slot].userid == userid &&
+		    pgds->drainers[free_slot].pid == 0)
+			memset(&pgds->drainers[free_slot], 0, sizeof(pgdsDrainer));
+		LWLockRelease(pgds->lock);
+	}
+}
+
+/*
+ * pgds_launch_workers_for
+ *
+ * start background workers draining the work queue for dboid and userid:
+ * a drainer worker takes the drainer slot of dboid and userid
+ */
+static int pgds_launch_workers_for(Oid dboid, Oid userid, int nworkers, BackgroundWorkerHandle **handles,
+				   bool drainer)
+{
+	BackgroundWorker worker;
+	int i;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS | BGWORKER_BACKEND_DATABASE_CONNECTION;
+	worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	snprintf(worker.bgw_library_name, BGW_MAXLEN, "pgds");
+	snprintf(worker.bgw_function_name, BGW_MAXLEN, "pgds_worker_main");
+	snprintf(worker.bgw_name, BGW_MAXLEN, "pgds worker for database %u", dboid);
+#if PG_VERSION_NUM >= 110000
+	snprintf(worker.bgw_type, BGW_MAXLEN, "pgds worker");
+#endif
+	worker.bgw_main_arg = ObjectIdGetDatum(dboid);
+	memcpy(worker.bgw_extra, &userid, sizeof(Oid));
+	memcpy(worker.bgw_extra + sizeof(Oid), &drainer, sizeof(bool));
+	worker.bgw_notify_pid = MyProcPid;
+
+	for (i = 0; i < nworkers; i++)
+	{
+		if (!RegisterDynamicBackgroundWorker(&worker, &handles[i]))
+		{
+			elog(LOG, "pgds: could only start %d of %d background workers (max_worker_processes)", i, nworkers);
+			break;
+		}
+	}
+
+	return i;
+}
+
+/*
+ * pgds_worker_main
+ *
+ * background worker entry point: run queued work items for one database
+ */
+void pgds_worker_main(Datum main_arg)
+{
+	Oid	dboid = DatumGetObjectId(main_arg);
+	Oid	userid;
+	pgdsWorkItem item;
+
+	memcpy(&userid, MyBgworkerEntry->bgw_extra, sizeof(Oid));
+	memcpy(&pgds_is_drainer, MyBgworkerEntry->bgw_extra + sizeof(Oid), sizeof(bool));
+
+	pqsignal(SIGTERM, die);
+#if PG_VERSION_NUM >= 130000
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+#endif
+	BackgroundWorkerUnblockSignals();
+#if PG_VERSION_NUM >= 110000
+	BackgroundWorkerInitializeConnectionByOid(dboid, userid, 0);
+#else
+	BackgroundWorkerInitializeConnectionByOid(dboid, userid);
+#endif
+
+	/* ANALYZE run by SPI must not trigger pgds_analyze */
+	pgds_avoid_recursion = 1;
+	pgds_is_worker = true;
+
+	pgds_vacuum_context = AllocSetContextCreate(TopMemoryContext,
+						    "pgds vacuum",
+						    ALLOCSET_DEFAULT_SIZES);
+
+	if (pgds_is_drainer)
+	{
+		int	i;
+
+		before_shmem_exit(pgds_drainer_exit, (Datum) 0);
+		LWLockAcquire(pgds->lock, LW_EXCLUSIVE);
+		for (i = 0; i < PGDS_DRAINERS; i++)
+			if (pgds->drainers[i].dboid == dboid && pgds->drainers[i].userid == userid &&
+			    pgds->drainers[i].pid == 0)
+			{
+				pgds->drainers[i].pid = MyProcPid;
+				break;
+			}
+		/* slot was reused after start timeout: another drainer runs */
+		if (i == PGDS_DRAINERS)
+			pgds_is_drainer = false;
+		LWLockRelease(pgds->lock);
+	}
+
+	while (pgds_dequeue_work(dboid, userid, false, &item))
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		if (item.kind == PGDS_WORK_VACUUM)
+		{
+			pgds_vacuum(&item);
+			continue;
+		}
+		/* running analysis is released at commit */
+		if (item.kind == PGDS_WORK_ANALYZE || item.kind == PGDS_WORK_ANALYZE_MISSING)
+			(void) pgds_governor_wait(item.relid, false);
+
+		SetCurrentStatementStartTimestamp();
+		StartTransactionCommand();
+		SPI_connect();
+		PushActiveSnapshot(GetTransactionSnapshot());
+		pgstat_report_activity(STATE_RUNNING, "pgds worker");
+
+		pgds_execute_work_item(&item);
+
+		SPI_finish();
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+		pgstat_report_activity(STATE_IDLE, NULL);
+	}
+
+	proc_exit(0);
+}
+
+#if PG_VERSION_NUM >= 130000
+/*
+ * pgds_demand_wait
+ *
+ * wait until socket of conn is ready for io_flag: latch stays responsive so
+ * that worker exits on shutdown request. Returns false on shutdown request.
+ */
+static bool pgds_demand_wait(PGconn *conn, int io_flag)
+{
+	for (;;)
+	{
+		int	rc;
+
+		rc = WaitLatchOrSocket(MyLatch, WL_EXIT_ON_PM_DEATH | WL_LATCH_SET | io_flag,
+				       PQsocket(conn), 0, pgds_we_demand_pull);
+		if (rc & WL_LATCH_SET)
+		{
+			ResetLatch(MyLatch);
+			CHECK_FOR_INTERRUPTS();
+			if (ShutdownRequestPending)
+				return false;
+		}
+		if (rc & io_flag)
+			return true;
+	}
+}
+
+/*
+ * pgds_demand_connect
+ *
+ * connect to standby without blocking: returns NULL on failure or shutdown
+ * request
+ */
+static PGconn *pgds_demand_connect(void)
+{
+	PGconn	*conn;
+	PostgresPollingStatusType status = PGRES_POLLING_WRITING;
+
+	conn = PQconnectStart(pgds_standby_conninfo);
+	if (conn == NULL)
+		return NULL;
+
+	while (PQstatus(conn) != CONNECTION_BAD &&
+	       status != PGRES_POLLING_OK && status != PGRES_POLLING_FAILED)
+	{
+		if (!pgds_demand_wait(conn, status == PGRES_POLLING_READING ?
+				      WL_SOCKET_READABLE : WL_SOCKET_WRITEABLE))
+		{
+			PQfinish(conn);
+			return NULL;
+		}
+		status = PQconnectPoll(conn);
+	}
+
+	if (PQstatus(conn) != CONNECTION_OK)
+	{
+		elog(LOG, "pgds: cannot connect to standby: %s", pchomp(PQerrorMessage(conn)));
+		PQfinish(conn);
+		return NULL;
+	}
+
+	return conn;
+}
+
+/*
+ * pgds_demand_exec
+ *
+ * run query on standby without blocking: returns last result, NULL on
+ * shutdown request
+ */
+static PGresult *pgds_demand_exec(PGconn *conn, const char *query)
+{
+	PGresult *res = NULL;
+
+	if (!PQsendQuery(conn, query))
+		return PQmakeEmptyPGresult(conn, PGRES_FATAL_ERROR);
+
+	for (;;)
+	{
+		PGresult *next;
+
+		while (PQisBusy(conn))
+		{
+			if (!pgds_demand_wait(conn, WL_SOCKET_READABLE))
+			{
+				PQclear(res);
+				return NULL;
+			}
+			if (!PQconsumeInput(conn))
+			{
+				PQclear(res);
+				return PQmakeEmptyPGresult(conn, PGRES_FATAL_ERROR);
+			}
+		}
+		next = PQgetResult(conn);
+		if (next == NULL)
+			break;
+		PQclear(res);
+		res = next;
+	}
+
+	return res;
+}
+
+/*
+ * pgds_demand_pull
+ *
+ * read standby demand, queue ANALYZE of relations for pgds workers as
+ * relation owner and acknowledge queued demands: a demand not queued
+ * (work queue full) stays on the standby until next pull
+ */
+static void pgds_demand_pull(void)
+{
+	PGconn	*conn;
+	PGresult *res;
+	PGresult *ack;
+	StringInfoData buf;
+	Oid	dboids[64];
+	Oid	userids[64];
+	int	ndrainers = 0;
+	int	nqueued = 0;
+	int	i;
+	int	j;
+
+	conn = pgds_demand_connect();
+	if (conn == NULL)
+		return;
+
+	res = pgds_demand_exec(conn, "select dbid, relid, relowner, last_demand from pgds_standby_demand()");
+	if (res == NULL)
+	{
+		PQfinish(conn);
+		return;
+	}
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+	{
+		elog(LOG, "pgds: cannot read standby demand: %s", pchomp(PQerrorMessage(conn)));
+		PQclear(res);
+		PQfinish(conn);
+		return;
+	}
+
+	/* relation oids and owners are the same on primary and physical standby */
+	initStringInfo(&buf);
+	for (i = 0; i < PQntuples(res); i++)
+	{
+		pgdsWorkItem item;
+
+		memset(&item, 0, sizeof(item));
+		item.kind = PGDS_WORK_ANALYZE_MISSING;
+		item.dboid = atooid(PQgetvalue(res, i, 0));
+		item.relid = atooid(PQgetvalue(res, i, 1));
+		item.userid = atooid(PQgetvalue(res, i, 2));
+		if (!pgds_enqueue_work(&item))
+		{
+			elog(LOG, "pgds: work queue is full: standby demand for relation %u left on standby", item.relid);
+			continue;
+		}
+		appendStringInfo(&buf, "%s(%u, %u, '%s')", nqueued == 0 ? "" : ", ",
+				 item.dboid, item.relid, PQgetvalue(res, i, 3));
+		nqueued++;
+		for (j = 0; j < ndrainers; j++)
+			if (dboids[j] == item.dboid && userids[j] == item.userid)
+				break;
+		if (j == ndrainers && ndrainers < lengthof(dboids))
+		{
+			dboids[ndrainers] = item.dboid;
+			userids[ndrainers] = item.userid;
+			ndrainers++;
+		}
+	}
+	elog(DEBUG1, "pgds: %d standby demands queued", nqueued);
+	PQclear(res);
+
+	if (nqueued > 0)
+	{
+		char *query;
+
+		query = psprintf("select count(*) from (values %s) v(d, r, t) "
+				 "where pgds_standby_demand_ack(d::oid, r::oid, t::timestamptz)", buf.data);
+		ack = pgds_demand_exec(conn, query);
+		if (ack != NULL && PQresultStatus(ack) != PGRES_TUPLES_OK)
+			elog(LOG, "pgds: cannot acknowledge standby demand: %s", pchomp(PQerrorMessage(conn)));
+		if (ack != NULL)
+			PQclear(ack);
+		pfree(query);
+	}
+	pfree(buf.data);
+	PQfinish(conn);
+
+	for (j = 0; j < ndrainers; j++)
+		pgds_launch_drainer(dboids[j], userids[j]);
+}
+
+/*
+ * pgds_demand_worker_main
+ *
+ * primary side background worker: pull standby demand every
+ * pgds.standby_poll_interval
+ */
+void pgds_demand_worker_main(Datum main_arg)
+{
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	pqsignal(SIGTERM, SignalHandlerForShutdownRequest);
+	BackgroundWorkerUnblockSignals();
+
+	pgds_init_wait_events();
+
+	while (!ShutdownRequestPending)
+	{
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+				 pgds_standby_poll_interval * 1000L, pgds_we_demand_pull);
+		ResetLatch(MyLatch);
+		CHECK_FOR_INTERRUPTS();
+
+		if (ConfigReloadPending)
+		{
+			ConfigReloadPending = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		if (!ShutdownRequestPending &&
+		    pgds_standby_conninfo != NULL && pgds_standby_conninfo[0] != '\0')
+			pgds_demand_pull();
+	}
+
+	proc_exit(0);
+}
+#endif
+
+/*
+ * pgds_prewarm_add_rte
+ *
+ * record relation and selected columns of a range table entry
+ */
+static void pgds_prewarm_add_rte(pgdsPrewarmContext *ctx, Query *query, RangeTblEntry *rte)
+{
+	MemoryContext oldcxt;
+	pgdsPrewarmRel *prel = NULL;
+	Bitmapset *selected;
+	ListCell *lc;
+	int x;
+
+#if PG_VERSION_NUM >= 160000
+	if (rte->perminfoindex == 0)
+		selected = NULL;
+	else
+		selected = getRTEPermissionInfo(query->rteperminfos, rte)->selectedCols;
+#else
+	selected = rte->selectedCols;
+#endif
+
+	oldcxt = MemoryContextSwitchTo(ctx->mcxt);
+
+	foreach(lc, ctx->rels)
+	{
+		if (((pgdsPrewarmRel *) lfirst(lc))->relid == rte->relid)
+		{
+			prel = (pgdsPrewarmRel *) lfirst(lc);
+			break;
+		}
+	}
+	if (prel == NULL)
+	{
+		prel = (pgdsPrewarmRel *) palloc0(sizeof(pgdsPrewarmRel));
+		prel->relid = rte->relid;
+		ctx->rels = lappend(ctx->rels, prel);
+	}
+
+	/*
+	 * selectedCols is offset by FirstLowInvalidHeapAttributeNumber:
+	 * whole row reference needs all columns, system columns need none
+	 */
+	x = -1;
+	while ((x = bms_next_member(selected, x)) >= 0)
+	{
+		AttrNumber attno = x + FirstLowInvalidHeapAttributeNumber;
+
+		if (attno == InvalidAttrNumber)
+			prel->all_columns = true;
+		else if (attno > 0)
+			prel->attnums = bms_add_member(prel->attnums, attno);
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+}
+
+/*
+ * pgds_prewarm_parse
+ *
+ * parse and analyze (without executing) one query text and collect relations and columns:
+ * queries that cannot be analyzed (missing parameter types, dropped objects ...) are skipped
+ */
+static void pgds_prewarm_parse(const char *query_string, pgdsPrewarmContext *ctx, MemoryContext parsecxt)
+{
+	MemoryContext oldcxt = CurrentMemoryContext;
+	ResourceOwner oldowner = CurrentResourceOwner;
+
+	BeginInternalSubTransaction(NULL);
+	MemoryContextSwitchTo(parsecxt);
+
+	PG_TRY();
+	{
+		List	 *raw_list;
+		ListCell *lc;
+
+		raw_list = pg_parse_query(query_string);
+		foreach(lc, raw_list)
+		{
+			RawStmt *rs = lfirst_node(RawStmt, lc);
+			Oid	*param_types = NULL;
+			int	num_params = 0;
+			Query	*query;
+
+			if (!IsA(rs->stmt, SelectStmt) &&
+			    !IsA(rs->stmt, InsertStmt) &&
+			    !IsA(rs->stmt, UpdateStmt) &&
+#if PG_VERSION_NUM >= 150000
+			    !IsA(rs->stmt, MergeStmt) &&
+#endif
+			    !IsA(rs->stmt, DeleteStmt))
+				continue;
+
+#if PG_VERSION_NUM >= 150000
+			query = parse_analyze_varparams(rs, query_string, &param_types, &num_params, NULL);
+#else
+			query = parse_analyze_varparams(rs, query_string, &param_types, &num_params);
+#endif
+			(void) pgds_walk_query(query, ctx);
+			pgds_rel_index = 0;
+		}
+
+		ReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcxt);
+		CurrentResourceOwner = oldowner;
+	}
+	PG_CATCH();
+	{
+		ErrorData *edata;
+
+		MemoryContextSwitchTo(parsecxt);
+		edata = CopyErrorData();
+		FlushErrorState();
+
+		RollbackAndReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcxt);
+		CurrentResourceOwner = oldowner;
+
+		elog(DEBUG1, "pgds: pgds_prewarm_parse: skipping \"%s\": %s", query_string, edata->message);
+		pgds_rel_index = 0;
+	}
+	PG_END_TRY();
+
+	MemoryContextReset(parsecxt);
+}
+
+/*
+ * pgds_prewarm_missing_attnums
+ *
+ * returns columns of table rel_id without statistics
+ */
+static Bitmapset *pgds_prewarm_missing_attnums(Oid rel_id)
+{
+	StringInfoData buf_select;
+	Bitmapset *missing = NULL;
+	bool isnull;
+	int ret;
+	uint64 j;
+
+	initStringInfo(&buf_select);
+	appendStringInfo(&buf_select,
+			 "select a.attnum from pg_attribute a where a.attrelid = %u "
+			 "and a.attnum > 0 and not a.attisdropped "
+			 "and not exists (select 1 from pg_statistic s "
+			 "where s.starelid = a.attrelid and s.staattnum = a.attnum)", rel_id);
+	ret = SPI_execute(buf_select.data, true, 0);
+	if (ret != SPI_OK_SELECT)
+		elog(ERROR, "pgds: cannot select from pg_attribute for rel_id: %u error code: %d", rel_id, ret);
+
+	for (j = 0; j < SPI_processed; j++)
+		missing = bms_add_member(missing,
+					 DatumGetInt16(SPI_getbinval(SPI_tuptable->vals[j],
+								     SPI_tuptable->tupdesc, 1, &isnull)));
+
+	return missing;
+}
+
+/*
+ * pgds_prewarm_add_item
+ *
+ * build work item for rel_id and report it: columns is NULL for all columns
+ */
+static void pgds_prewarm_add_item(List **items, Oid rel_id, Bitmapset *columns,
+				  Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	pgdsWorkItem	*item;
+	StringInfoData	buf;
+	Datum		values[2];
+	bool		nulls[2] = {false, false};
+	int		x;
+
+	item = (pgdsWorkItem *) palloc0(sizeof(pgdsWorkItem));
+	item->kind = PGDS_WORK_ANALYZE;
+	item->dboid = MyDatabaseId;
+	item->userid = GetUserId();
+	item->relid = rel_id;
+
+	initStringInfo(&buf);
+	x = -1;
+	while ((x = bms_next_member(columns, x)) >= 0)
+	{
+		if (item->natts == MAX_WORK_ATTS)
+		{
+			item->natts = 0;
+			break;
+		}
+		if (item->natts > 0)
+			appendStringInfoString(&buf, ", ");
+		appendStringInfoString(&buf, get_attname(rel_id, x, false));
+		item->attnums[item->natts++] = x;
+	}
+
+	values[0] = ObjectIdGetDatum(rel_id);
+	if (item->natts > 0)
+		values[1] = CStringGetTextDatum(buf.data);
+	else
+		nulls[1] = true;
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+	*items = lappend(*items, item);
+}
+
+/*
+ * pgds_prewarm_from_statements
+ *
+ * parse and analyze (without executing) each query text from pg_stat_statements
+ * (or from the query column of the given table) and ANALYZE the table columns
+ * these queries need that have no statistics, using background workers if requested.
+ */
+Datum pgds_prewarm_from_statements(PG_FUNCTION_ARGS)
+{
+	Oid		queries_relid = PG_ARGISNULL(0) ? InvalidOid : PG_GETARG_OID(0);
+	int		nworkers = PG_ARGISNULL(1) ? 0 : PG_GETARG_INT32(1);
+	Tuplestorestate	*tupstore;
+	TupleDesc	tupdesc;
+	StringInfoData	buf_select;
+	pgdsPrewarmContext ctx;
+	MemoryContext	parsecxt;
+	BackgroundWorkerHandle **handles;
+	List		*queries = NIL;
+	List		*items = NIL;
+	ListCell	*lc;
+	pgdsWorkItem	item;
+	int		nlaunched = 0;
+	int		ret;
+	int		i;
+	uint64		j;
+
+	tupstore = pgds_init_srf(fcinfo, &tupdesc);
+
+	if (nworkers > 0 && pgds == NULL)
+		elog(ERROR, "pgds: background workers require pgds in shared_preload_libraries");
+
+	initStringInfo(&buf_select);
+	if (OidIsValid(queries_relid))
+	{
+		appendStringInfo(&buf_select, "select query::text from %s where query is not null",
+				 pgds_qualified_name(queries_relid));
+	}
+	else
+	{
+		Oid pgss_relid = RelnameGetRelid("pg_stat_statements");
+
+		if (!OidIsValid(pgss_relid))
+			elog(ERROR, "pgds: pg_stat_statements is not installed in search_path and no query table given");
+		appendStringInfo(&buf_select, "select query from %s where dbid = %u and query is not null",
+				 pgds_qualified_name(pgss_relid), MyDatabaseId);
+	}
+
+	ctx.mcxt = CurrentMemoryContext;
+	ctx.rels = NIL;
+	parsecxt = AllocSetContextCreate(CurrentMemoryContext, "pgds prewarm parse",
+					 ALLOCSET_DEFAULT_SIZES);
+
+	pgds_avoid_recursion++;
+	PG_TRY();
+	{
+		SPI_connect();
+
+		ret = SPI_execute(buf_select.data, true, 0);
+		if (ret != SPI_OK_SELECT)
+			elog(ERROR, "pgds: cannot read queries: error code: %d", ret);
+		for (j = 0; j < SPI_processed; j++)
+			queries = lappend(queries, SPI_getvalue(SPI_tuptable->vals[j], SPI_tuptable->tupdesc, 1));
+
+		/*
+		 * 1. collect relations and columns needed by all queries
+		 */
+		foreach(lc, queries)
+			pgds_prewarm_parse((char *) lfirst(lc), &ctx, parsecxt);
+
+		/*
+		 * 2. find columns without statistics: views are expanded to their tables
+		 */
+		foreach(lc, ctx.rels)
+		{
+			pgdsPrewarmRel *prel = (pgdsPrewarmRel *) lfirst(lc);
+			char	relkind = get_rel_relkind(prel->relid);
+			Bitmapset *missing;
+
+			if (relkind == RELKIND_VIEW)
+			{
+				pgds_build_table_array(prel->relid);
+				for (i = 0; i < pgds_table_index; i++)
+				{
+					if (!superuser() && GetUserId() != pgds_tableowner_array[i])
+						continue;
+					missing = pgds_prewarm_missing_attnums(pgds_tableoid_array[i]);
+					if (!bms_is_empty(missing))
+						pgds_prewarm_add_item(&items, pgds_tableoid_array[i], missing, tupstore, tupdesc);
+				}
+				pgds_table_index = 0;
+				continue;
+			}
+
+			if (relkind != RELKIND_RELATION && relkind != RELKIND_PARTITIONED_TABLE)
+				continue;
+			if (!prel->all_columns && bms_is_empty(prel->attnums))
+				continue;
+			if (!superuser() && GetUserId() != pgds_rel_owner(prel->relid))
+				continue;
+
+			missing = pgds_prewarm_missing_attnums(prel->relid);
+			if (!prel->all_columns)
+				missing = bms_int_members(missing, prel->attnums);
+			if (!bms_is_empty(missing))
+				pgds_prewarm_add_item(&items, prel->relid, missing, tupstore, tupdesc);
+		}
+
+		/*
+		 * 3. analyze: queued items are shared between background workers and this backend
+		 */
+		if (nworkers > 0 && items != NIL)
+		{
+			foreach(lc, items)
+			{
+				if (!pgds_enqueue_work((pgdsWorkItem *) lfirst(lc)))
+					pgds_prewarm_execute((pgdsWorkItem *) lfirst(lc));
+			}
+			handles = (BackgroundWorkerHandle **) palloc0(sizeof(BackgroundWorkerHandle *) * nworkers);
+			nlaunched = pgds_launch_workers(Min(nworkers, list_length(items)), handles);
+
+			/* VACUUM cannot run in this transaction: left to workers */
+			while (pgds_dequeue_work(MyDatabaseId, GetUserId(), true, &item))
+			{
+				CHECK_FOR_INTERRUPTS();
+				pgds_prewarm_execute(&item);
+			}
+
+			for (i = 0; i < nlaunched; i++)
+				(void) WaitForBackgroundWorkerShutdown(handles[i]);
+		}
+		else
+		{
+			foreach(lc, items)
+				pgds_prewarm_execute((pgdsWorkItem *) lfirst(lc));
+		}
+
+		SPI_finish();
+	}
+	PG_CATCH();
+	{
+		pgds_avoid_recursion--;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	pgds_avoid_recursion--;
+
+	MemoryContextDelete(parsecxt);
+
+	return (Datum) 0;
+}
+
+
+/*
+ * Statistics export/import file format (integers and floats in network byte order):
+ *
+ * header:	"PGDSSTAT" uint32 format version, uint32 PG_VERSION_NUM of exporting server
+ * 'R' record:	relation: nspname, relname, relpages, reltuples, relallvisible
+ * 'A' record:	pg_statistic row of previous relation: attname, attribute type,
+ *		stainherit, stanullfrac, stawidth, stadistinct and for each slot:
+ *		stakind, operator, collation schema and name, stanumbers, stavalues type and stavalues
+ * 'X' record:	pg_statistic_ext_data row of previous relation: statistics object schema and name,
+ *		column names and type oids, stxdinherit, stxdndistinct, stxddependencies, stxdmcv
+ * 'E' record:	end of file
+ *
+ * Strings are stored as int32 length followed by bytes (length -1 is NULL).
+ * Catalog objects are stored by name so that statistics can be loaded in another cluster.
+ * stanumbers and stavalues are stored in array text form, which is read
+ * with element type found by name in any cluster. Extended statistics are
+ * stored in their serialized form, which depends on server architecture and
+ * major version: they are only imported by a server of the same major
+ * version, and MCV lists, which hold type oids, only if column types have
+ * the same oids.
+ */
+#define	PGDS_STATS_MAGIC	"PGDSSTAT"
+#define	PGDS_STATS_VERSION	3
+
+typedef struct pgdsStatsFile
+{
+	FILE	*file;
+	const char *filename;
+} pgdsStatsFile;
+
+static void pgds_write_bytes(pgdsStatsFile *sf, const void *data, size_t len)
+{
+	if (len > 0 && fwrite(data, 1, len, sf->file) != len)
+		elog(ERROR, "pgds: could not write file \"%s\": %m", sf->filename);
+}
+
+static void pgds_read_bytes(pgdsStatsFile *sf, void *data, size_t len)
+{
+	if (len > 0 && fread(data, 1, len, sf->file) != len)
+		elog(ERROR, "pgds: could not read file \"%s\": unexpected end of file", sf->filename);
+}
+
+/* 4 byte value (int32, uint32 or float4) in network byte order */
+static void pgds_write_net32(pgdsStatsFile *sf, const void *data)
+{
+	uint32 n;
+
+	memcpy(&n, data, sizeof(n));
+	n = pg_hton32(n);
+	pgds_write_bytes(sf, &n, sizeof(n));
+}
+
+static void pgds_read_net32(pgdsStatsFile *sf, void *data)
+{
+	uint32 n;
+
+	pgds_read_bytes(sf, &n, sizeof(n));
+	n = pg_ntoh32(n);
+	memcpy(data, &n, sizeof(n));
+}
+
+static void pgds_write_net16(pgdsStatsFile *sf, const void *data)
+{
+	uint16 n;
+
+	memcpy(&n, data, sizeof(n));
+	n = pg_hton16(n);
+	pgds_write_bytes(sf, &n, sizeof(n));
+}
+
+static void pgds_read_net16(pgdsStatsFile *sf, void *data)
+{
+	uint16 n;
+
+	pgds_read_bytes(sf, &n, sizeof(n));
+	n = pg_ntoh16(n);
+	memcpy(data, &n, sizeof(n));
+}
+
+static void pgds_write_string(pgdsStatsFile *sf, const char *str)
+{
+	int32 len = (str == NULL) ? -1 : strlen(str);
+
+	pgds_write_net32(sf, &len);
+	if (len > 0)
+		pgds_write_bytes(sf, str, len);
+}
+
+static char *pgds_read_string(pgdsStatsFile *sf)
+{
+	int32 len;
+	char *str;
+
+	pgds_read_net32(sf, &len);
+	if (len < 0)
+		return NULL;
+	if (len > MaxAllocSize - 1)
+		elog(ERROR, "pgds: invalid string length %d in file \"%s\"", len, sf->filename);
+	str = palloc(len + 1);
+	pgds_read_bytes(sf, str, len);
+	str[len] = '\0';
+
+	return str;
+}
+
+static void pgds_write_varlena(pgdsStatsFile *sf, Datum value, bool isnull)
+{
+	struct varlena *v;
+	int32 len;
+
+	if (isnull)
+	{
+		len = -1;
+		pgds_write_net32(sf, &len);
+		return;
+	}
+	v = PG_DETOAST_DATUM(value);
+	len = VARSIZE_ANY_EXHDR(v);
+	pgds_write_net32(sf, &len);
+	pgds_write_bytes(sf, VARDATA_ANY(v), len);
+}
+
+static Datum pgds_read_varlena(pgdsStatsFile *sf, bool *isnull)
+{
+	struct varlena *v;
+	int32 len;
+
+	pgds_read_net32(sf, &len);
+	*isnull = (len < 0);
+	if (len < 0)
+		return (Datum) 0;
+	if (len > MaxAllocSize - VARHDRSZ)
+		elog(ERROR, "pgds: invalid value length %d in file \"%s\"", len, sf->filename);
+	v = (struct varlena *) palloc(len + VARHDRSZ);
+	SET_VARSIZE(v, len + VARHDRSZ);
+	pgds_read_bytes(sf, VARDATA(v), len);
+
+	return PointerGetDatum(v);
+}
+
+/*
+ * pgds_lookup_regobject
+ *
+ * resolve object name with to_regtype or to_regoperator: caller must be connected to SPI
+ */
+static Oid pgds_lookup_regobject(const char *func, const char *name)
+{
+	StringInfoData buf;
+	Oid	argtypes[1] = {TEXTOID};
+	Datum	values[1];
+	bool	isnull;
+	Oid	result = InvalidOid;
+	int	ret;
+
+	if (name == NULL)
+		return InvalidOid;
+
+	initStringInfo(&buf);
+	appendStringInfo(&buf, "select %s($1)::oid", func);
+	values[0] = CStringGetTextDatum(name);
+	ret = SPI_execute_with_args(buf.data, 1, argtypes, values, NULL, true, 1);
+	if (ret == SPI_OK_SELECT && SPI_processed == 1)
+	{
+		Datum d = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &isnull);
+
+		if (!isnull)
+			result = DatumGetObjectId(d);
+	}
+
+	return result;
+}
+
+/*
+ * pgds_export_rel_stats
+ *
+ * write pg_class, pg_statistic and pg_statistic_ext_data data of one relation
+ */
+static int64 pgds_export_rel_stats(pgdsStatsFile *sf, Oid relid)
+{
+	HeapTuple	ctup;
+	Form_pg_class	classform;
+	Relation	sd;
+	ScanKeyData	key;
+	SysScanDesc	scan;
+	HeapTuple	tup;
+	char		tag;
+	int64		nrows = 0;
+	int		k;
+
+	ctup = SearchSysCache1(RELOID, ObjectIdGetDatum(relid));
+	if (!HeapTupleIsValid(ctup))
+		elog(ERROR, "pgds: cache lookup failed for relation %u", relid);
+	classform = (Form_pg_class) GETSTRUCT(ctup);
+
+	tag = 'R';
+	pgds_write_bytes(sf, &tag, 1);
+	pgds_write_string(sf, get_namespace_name(classform->relnamespace));
+	pgds_write_string(sf, NameStr(classform->relname));
+	pgds_write_net32(sf, &classform->relpages);
+	pgds_write_net32(sf, &classform->reltuples);
+	pgds_write_net32(sf, &classform->relallvisible);
+	ReleaseSysCache(ctup);
+
+	/*
+	 * pg_statistic
+	 */
+	sd = table_open(StatisticRelationId, AccessShareLock);
+	ScanKeyInit(&key, Anum_pg_statistic_starelid, BTEqualStrategyNumber, F_OIDEQ, ObjectIdGetDatum(relid));
+	scan = systable_beginscan(sd, StatisticRelidAttnumInhIndexId, true, NULL, 1, &key);
+	while (HeapTupleIsValid(tup = systable_getnext(scan)))
+	{
+		Form_pg_statistic stats = (Form_pg_statistic) GETSTRUCT(tup);
+
+		tag = 'A';
+		pgds_write_bytes(sf, &tag, 1);
+		pgds_write_string(sf, get_attname(relid, stats->staattnum, false));
+		pgds_write_string(sf, format_type_be_qualified(get_atttype(relid, stats->staattnum)));
+		pgds_write_bytes(sf, &stats->stainherit, sizeof(bool));
+		pgds_write_net32(sf, &stats->stanullfrac);
+		pgds_write_net32(sf, &stats->stawidth);
+		pgds_write_net32(sf, &stats->stadistinct);
+
+		for (k = 0; k < STATISTIC_NUM_SLOTS; k++)
+		{
+			int16	kind = (&stats->stakind1)[k];
+			Oid	op = (&stats->staop1)[k];
+			Oid	coll = (&stats->stacoll1)[k];
+			Datum	d;
+			bool	isnull;
+
+			pgds_write_net16(sf, &kind);
+			pgds_write_string(sf, OidIsValid(op) ? format_operator_qualified(op) : NULL);
+			if (OidIsValid(coll))
+			{
+				HeapTuple colltup = SearchSysCache1(COLLOID, ObjectIdGetDatum(coll));
+
+				if (!HeapTupleIsValid(colltup))
+					elog(ERROR, "pgds: cache lookup failed for collation %u", coll);
+				pgds_write_string(sf, get_namespace_name(((Form_pg_collation) GETSTRUCT(colltup))->collnamespace));
+				pgds_write_string(sf, NameStr(((Form_pg_collation) GETSTRUCT(colltup))->collname));
+				ReleaseSysCache(colltup);
+			}
+			else
+			{
+				pgds_write_string(sf, NULL);
+				pgds_write_string(sf, NULL);
+			}
+
+			d = heap_getattr(tup, Anum_pg_statistic_stanumbers1 + k, RelationGetDescr(sd), &isnull);
+			pgds_write_string(sf, isnull ? NULL : OidOutputFunctionCall(F_ARRAY_OUT, d));
+
+			d = heap_getattr(tup, Anum_pg_statistic_stavalues1 + k, RelationGetDescr(sd), &isnull);
+			if (isnull)
+			{
+				pgds_write_string(sf, NULL);
+				pgds_write_string(sf, NULL);
+			}
+			else
+			{
+				pgds_write_string(sf, format_type_be_qualified(ARR_ELEMTYPE(DatumGetArrayTypeP(d))));
+				pgds_write_string(sf, OidOutputFunctionCall(F_ARRAY_OUT, d));
+			}
+		}
+		nrows++;
+	}
+	systable_endscan(scan);
+	table_close(sd, AccessShareLock);
+
+	/*
+	 * pg_statistic_ext_data: serialized statistics are stored as is,
+	 * expression statistics are not exported
+	 */
+	sd = table_open(StatisticExtRelationId, AccessShareLock);
+	ScanKeyInit(&key, Anum_pg_statistic_ext_stxrelid, BTEqualStrategyNumber, F_OIDEQ, ObjectIdGetDatum(relid));
+	scan = systable_beginscan(sd, StatisticExtRelidIndexId, true, NULL, 1, &key);
+	while (HeapTupleIsValid(tup = systable_getnext(scan)))
+	{
+		Form_pg_statistic_ext stxform = (Form_pg_statistic_ext) GETSTRUCT(tup);
+		int2vector *stxkeys;
+		bool	isnull;
+		int	inh;
+
+		stxkeys = (int2vector *) DatumGetPointer(heap_getattr(tup, Anum_pg_statistic_ext_stxkeys,
+								     RelationGetDescr(sd), &isnull));
+
+		for (inh = 0; inh <= 1; inh++)
+		{
+			HeapTuple	dtup;
+			bool		stxdinherit = (inh == 1);
+			int32		nkeys = stxkeys->dim1;
+
+#if PG_VERSION_NUM >= 150000
+			dtup = SearchSysCache2(STATEXTDATASTXOID, ObjectIdGetDatum(stxform->oid), BoolGetDatum(stxdinherit));
+#else
+			if (stxdinherit)
+				break;
+			dtup = SearchSysCache1(STATEXTDATASTXOID, ObjectIdGetDatum(stxform->oid));
+#endif
+			if (!HeapTupleIsValid(dtup))
+				continue;
+
+			tag = 'X';
+			pgds_write_bytes(sf, &tag, 1);
+			pgds_write_string(sf, get_namespace_name(stxform->stxnamespace));
+			pgds_write_string(sf, NameStr(stxform->stxname));
+			pgds_write_net32(sf, &nkeys);
+			for (k = 0; k < nkeys; k++)
+			{
+				Oid	atttypid = get_atttype(relid, stxkeys->values[k]);
+
+				pgds_write_string(sf, get_attname(relid, stxkeys->values[k], false));
+				pgds_write_net32(sf, &atttypid);
+			}
+			pgds_write_bytes(sf, &stxdinherit, sizeof(bool));
+			pgds_write_varlena(sf, SysCacheGetAttr(STATEXTDATASTXOID, dtup, Anum_pg_statistic_ext_data_stxdndistinct, &isnull), isnull);
+			pgds_write_varlena(sf, SysCacheGetAttr(STATEXTDATASTXOID, dtup, Anum_pg_statistic_ext_data_stxddependencies, &isnull), isnull);
+			pgds_write_varlena(sf, SysCacheGetAttr(STATEXTDATASTXOID, dtup, Anum_pg_statistic_ext_data_stxdmcv, &isnull), isnull);
+			ReleaseSysCache(dtup);
+			nrows++;
+		}
+	}
+	systable_endscan(scan);
+	table_close(sd, AccessShareLock);
+
+	return nrows;
+}
+
+/*
+ * pgds_export_stats
+ *
+ * write statistics of given relations to server file: returns number of statistics rows written
+ */
+Datum pgds_export_stats(PG_FUNCTION_ARGS)
+{
+	ArrayType	*rels;
+	char		*filename;
+	Datum		*elems;
+	bool		*elem_nulls;
+	int		nelems;
+	pgdsStatsFile	sf;
+	uint32		version = PGDS_STATS_VERSION;
+	uint32		server_version = PG_VERSION_NUM;
+	char		tag = 'E';
+	int64		nrows = 0;
+	int		i;
+
+	if (!superuser())
+		elog(ERROR, "pgds: must be superuser to export statistics to a file");
+	if (PG_ARGISNULL(0) || PG_ARGISNULL(1))
+		elog(ERROR, "pgds: relation array and file name must not be NULL");
+
+	rels = PG_GETARG_ARRAYTYPE_P(0);
+	filename = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	deconstruct_array(rels, REGCLASSOID, sizeof(Oid), true, 'i', &elems, &elem_nulls, &nelems);
+
+	sf.filename = filename;
+	sf.file = AllocateFile(filename, PG_BINARY_W);
+	if (sf.file == NULL)
+		elog(ERROR, "pgds: could not open file \"%s\" for writing: %m", filename);
+
+	pgds_write_bytes(&sf, PGDS_STATS_MAGIC, strlen(PGDS_STATS_MAGIC));
+	pgds_write_net32(&sf, &version);
+	pgds_write_net32(&sf, &server_version);
+
+	for (i = 0; i < nelems; i++)
+	{
+		if (elem_nulls[i])
+			continue;
+		nrows += pgds_export_rel_stats(&sf, DatumGetObjectId(elems[i]));
+	}
+
+	pgds_write_bytes(&sf, &tag, 1);
+	if (FreeFile(sf.file) != 0)
+		elog(ERROR, "pgds: could not close file \"%s\": %m", filename);
+
+	PG_RETURN_INT64(nrows);
+}
+
+/*
+ * pgds_import_attr_stats
+ *
+ * read 'A' record and store it in pg_statistic if relid is valid and column matches
+ */
+static bool pgds_import_attr_stats(pgdsStatsFile *sf, Oid relid)
+{
+	Datum		values[Natts_pg_statistic];
+	bool		nulls[Natts_pg_statistic];
+	bool		replaces[Natts_pg_statistic];
+	char		*attname;
+	char		*atttypname;
+	AttrNumber	attnum = InvalidAttrNumber;
+	bool		stainherit;
+	float4		stanullfrac;
+	int32		stawidth;
+	float4		stadistinct;
+	bool		valid;
+	Relation	sd;
+	HeapTuple	oldtup;
+	HeapTuple	stup;
+	int		k;
+
+	memset(nulls, false, sizeof(nulls));
+	memset(replaces, true, sizeof(replaces));
+
+	attname = pgds_read_string(sf);
+	atttypname = pgds_read_string(sf);
+	pgds_read_bytes(sf, &stainherit, sizeof(bool));
+	pgds_read_net32(sf, &stanullfrac);
+	pgds_read_net32(sf, &stawidth);
+	pgds_read_net32(sf, &stadistinct);
+
+	valid = OidIsValid(relid) && attname != NULL;
+	if (valid)
+	{
+		attnum = get_attnum(relid, attname);
+		valid = (attnum != InvalidAttrNumber &&
+			 get_atttype(relid, attnum) == pgds_lookup_regobject("to_regtype", atttypname));
+		if (!valid)
+			elog(NOTICE, "pgds: skipping statistics of column \"%s\" of relation %u: no such column with type %s",
+			     attname, relid, atttypname);
+	}
+
+	values[Anum_pg_statistic_starelid - 1] = ObjectIdGetDatum(relid);
+	values[Anum_pg_statistic_staattnum - 1] = Int16GetDatum(attnum);
+	values[Anum_pg_statistic_stainherit - 1] = BoolGetDatum(stainherit);
+	values[Anum_pg_statistic_stanullfrac - 1] = Float4GetDatum(stanullfrac);
+	values[Anum_pg_statistic_stawidth - 1] = Int32GetDatum(stawidth);
+	values[Anum_pg_statistic_stadistinct - 1] = Float4GetDatum(stadistinct);
+
+	/* slots must be read even if the column is skipped */
+	for (k = 0; k < STATISTIC_NUM_SLOTS; k++)
+	{
+		int16	kind;
+		char	*opname;
+		char	*collnsp;
+		char	*collname;
+		char	*numbers;
+		char	*valtype;
+		char	*vals;
+		Oid	op = InvalidOid;
+		Oid	coll = InvalidOid;
+		Oid	valtypid = InvalidOid;
+
+		pgds_read_net16(sf, &kind);
+		opname = pgds_read_string(sf);
+		collnsp = pgds_read_string(sf);
+		collname = pgds_read_string(sf);
+		numbers = pgds_read_string(sf);
+		valtype = pgds_read_string(sf);
+		vals = pgds_read_string(sf);
+
+		if (!valid)
+			continue;
+
+		if (opname != NULL && !OidIsValid(op = pgds_lookup_regobject("to_regoperator", opname)))
+			valid = false;
+		if (collname != NULL &&
+		    !OidIsValid(coll = get_collation_oid(list_make2(makeString(collnsp), makeString(collname)), true)))
+			valid = false;
+		if (valtype != NULL && !OidIsValid(valtypid = pgds_lookup_regobject("to_regtype", valtype)))
+			valid = false;
+		if (!valid)
+		{
+			elog(NOTICE, "pgds: skipping statistics of column \"%s\" of relation %u: unknown operator, collation or type",
+			     attname, relid);
+			continue;
+		}
+
+		values[Anum_pg_statistic_stakind1 - 1 + k] = Int16GetDatum(kind);
+		values[Anum_pg_statistic_staop1 - 1 + k] = ObjectIdGetDatum(op);
+		values[Anum_pg_statistic_stacoll1 - 1 + k] = ObjectIdGetDatum(coll);
+		if (numbers != NULL)
+			values[Anum_pg_statistic_stanumbers1 - 1 + k] = OidInputFunctionCall(F_ARRAY_IN, numbers, FLOAT4OID, -1);
+		else
+			nulls[Anum_pg_statistic_stanumbers1 - 1 + k] = true;
+		if (vals != NULL)
+			values[Anum_pg_statistic_stavalues1 - 1 + k] = OidInputFunctionCall(F_ARRAY_IN, vals, valtypid, -1);
+		else
+			nulls[Anum_pg_statistic_stavalues1 - 1 + k] = true;
+	}
+
+	if (!valid)
+		return false;
+
+	sd = table_open(StatisticRelationId, RowExclusiveLock);
+	oldtup = SearchSysCache3(STATRELATTINH, ObjectIdGetDatum(relid), Int16GetDatum(attnum), BoolGetDatum(stainherit));
+	if (HeapTupleIsValid(oldtup))
+	{
+		stup = heap_modify_tuple(oldtup, RelationGetDescr(sd), values, nulls, replaces);
+		ReleaseSysCache(oldtup);
+		CatalogTupleUpdate(sd, &stup->t_self, stup);
+	}
+	else
+	{
+		stup = heap_form_tuple(RelationGetDescr(sd), values, nulls);
+		CatalogTupleInsert(sd, stup);
+	}
+	heap_freetuple(stup);
+	table_close(sd, RowExclusiveLock);
+
+	return true;
+}
+
+/*
+ * pgds_import_ext_stats
+ *
+ * read 'X' record and store it in pg_statistic_ext_data if statistics object
+ * exists for relid on the same columns and file has been exported by a
+ * server of the same major version. MCV list is left out if a column type
+ * has another oid.
+ */
+static bool pgds_import_ext_stats(pgdsStatsFile *sf, Oid relid, uint32 server_version)
+{
+	Datum		values[Natts_pg_statistic_ext_data];
+	bool		nulls[Natts_pg_statistic_ext_data];
+	bool		replaces[Natts_pg_statistic_ext_data];
+	char		*stxnsp;
+	char		*stxname;
+	int32		nkeys;
+	char		**keynames;
+	Oid		*keytypes;
+	bool		stxdinherit;
+	bool		sametypes = true;
+	Oid		stxoid = InvalidOid;
+	bool		valid;
+	Relation	sd;
+	HeapTuple	oldtup;
+	HeapTuple	stup;
+	int		k;
+
+	memset(nulls, true, sizeof(nulls));
+	memset(replaces, true, sizeof(replaces));
+
+	stxnsp = pgds_read_string(sf);
+	stxname = pgds_read_string(sf);
+	pgds_read_net32(sf, &nkeys);
+	if (nkeys < 0 || nkeys > STATS_MAX_DIMENSIONS)
+		elog(ERROR, "pgds: invalid number of columns %d in file \"%s\"", nkeys, sf->filename);
+	keynames = (char **) palloc0(sizeof(char *) * (nkeys + 1));
+	keytypes = (Oid *) palloc0(sizeof(Oid) * (nkeys + 1));
+	for (k = 0; k < nkeys; k++)
+	{
+		keynames[k] = pgds_read_string(sf);
+		pgds_read_net32(sf, &keytypes[k]);
+	}
+	pgds_read_bytes(sf, &stxdinherit, sizeof(bool));
+	values[Anum_pg_statistic_ext_data_stxdndistinct - 1] =
+		pgds_read_varlena(sf, &nulls[Anum_pg_statistic_ext_data_stxdndistinct - 1]);
+	values[Anum_pg_statistic_ext_data_stxddependencies - 1] =
+		pgds_read_varlena(sf, &nulls[Anum_pg_statistic_ext_data_stxddependencies - 1]);
+	values[Anum_pg_statistic_ext_data_stxdmcv - 1] =
+		pgds_read_varlena(sf, &nulls[Anum_pg_statistic_ext_data_stxdmcv - 1]);
+
+	valid = OidIsValid(relid);
+	if (valid)
+		stxoid = get_statistics_object_oid(list_make2(makeString(stxnsp), makeString(stxname)), true);
+	if (OidIsValid(stxoid))
+	{
+		/* serialized statistics refer to attribute numbers: these must match */
+		HeapTuple	stxtup = SearchSysCache1(STATEXTOID, ObjectIdGetDatum(stxoid));
+		int2vector	*stxkeys;
+		bool		isnull;
+
+		if (!HeapTupleIsValid(stxtup))
+			elog(ERROR, "pgds: cache lookup failed for statistics object %u", stxoid);
+		stxkeys = (int2vector *) DatumGetPointer(SysCacheGetAttr(STATEXTOID, stxtup,
+									 Anum_pg_statistic_ext_stxkeys, &isnull));
+		valid = (((Form_pg_statistic_ext) GETSTRUCT(stxtup))->stxrelid == relid && stxkeys->dim1 == nkeys);
+		for (k = 0; valid && k < nkeys; k++)
+		{
+			valid = (keynames[k] != NULL && get_attnum(relid, keynames[k]) == stxkeys->values[k]);
+			if (valid && get_atttype(relid, stxkeys->values[k]) != keytypes[k])
+				sametypes = false;
+		}
+		ReleaseSysCache(stxtup);
+	}
+	else
+		valid = false;
+
+	if (valid && server_version / 100 != PG_VERSION_NUM / 100)
+	{
+		elog(NOTICE, "pgds: skipping extended statistics \"%s.%s\": exported by server version %u",
+		     stxnsp, stxname, server_version);
+		return false;
+	}
+	if (valid && !sametypes && !nulls[Anum_pg_statistic_ext_data_stxdmcv - 1])
+	{
+		elog(NOTICE, "pgds: skipping MCV list of extended statistics \"%s.%s\": column types have other oids",
+		     stxnsp, stxname);
+		nulls[Anum_pg_statistic_ext_data_stxdmcv - 1] = true;
+	}
+
+#if PG_VERSION_NUM < 150000
+	if (stxdinherit)
+		valid = false;
+#endif
+
+	if (!valid)
+	{
+		if (OidIsValid(relid))
+			elog(NOTICE, "pgds: skipping extended statistics \"%s.%s\": no matching statistics object", stxnsp, stxname);
+		return false;
+	}
+
+	values[Anum_pg_statistic_ext_data_stxoid - 1] = ObjectIdGetDatum(stxoid);
+	nulls[Anum_pg_statistic_ext_data_stxoid - 1] = false;
+#if PG_VERSION_NUM >= 150000
+	values[Anum_pg_statistic_ext_data_stxdinherit - 1] = BoolGetDatum(stxdinherit);
+	nulls[Anum_pg_statistic_ext_data_stxdinherit - 1] = false;
+#endif
+
+	sd = table_open(StatisticExtDataRelationId, RowExclusiveLock);
+#if PG_VERSION_NUM >= 150000
+	oldtup = SearchSysCache2(STATEXTDATASTXOID, ObjectIdGetDatum(stxoid), BoolGetDatum(stxdinherit));
+#else
+	oldtup = SearchSysCache1(STATEXTDATASTXOID, ObjectIdGetDatum(stxoid));
+#endif
+	if (HeapTupleIsValid(oldtup))
+	{
+		stup = heap_modify_tuple(oldtup, RelationGetDescr(sd), values, nulls, replaces);
+		ReleaseSysCache(oldtup);
+		CatalogTupleUpdate(sd, &stup->t_self, stup);
+	}
+	else
+	{
+		stup = heap_form_tuple(RelationGetDescr(sd), values, nulls);
+		CatalogTupleInsert(sd, stup);
+	}
+	heap_freetuple(stup);
+	table_close(sd, RowExclusiveLock);
+
+	return true;
+}
+
+/*
+ * pgds_import_stats
+ *
+ * load statistics written by pgds_export_stats without sampling: relations are found
+ * by schema qualified name and columns by name. Returns number of statistics rows loaded.
+ */
+Datum pgds_import_stats(PG_FUNCTION_ARGS)
+{
+	char		*filename;
+	pgdsStatsFile	sf;
+	char		magic[sizeof(PGDS_STATS_MAGIC)];
+	uint32		version;
+	uint32		server_version;
+	Oid		relid = InvalidOid;
+	int64		nrows = 0;
+	char		tag;
+
+	if (!superuser())
+		elog(ERROR, "pgds: must be superuser to import statistics from a file");
+	if (PG_ARGISNULL(0))
+		elog(ERROR, "pgds: file name must not be NULL");
+
+	filename = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	sf.filename = filename;
+	sf.file = AllocateFile(filename, PG_BINARY_R);
+	if (sf.file == NULL)
+		elog(ERROR, "pgds: could not open file \"%s\" for reading: %m", filename);
+
+	pgds_read_bytes(&sf, magic, strlen(PGDS_STATS_MAGIC));
+	pgds_read_net32(&sf, &version);
+	pgds_read_net32(&sf, &server_version);
+	if (memcmp(magic, PGDS_STATS_MAGIC, strlen(PGDS_STATS_MAGIC)) != 0)
+		elog(ERROR, "pgds: file \"%s\" is not a pgds statistics file", filename);
+	if (version != PGDS_STATS_VERSION)
+		elog(ERROR, "pgds: file \"%s\" has unsupported format version %u", filename, version);
+	if (server_version / 100 != PG_VERSION_NUM / 100)
+		elog(NOTICE, "pgds: file \"%s\" has been exported by server version %u", filename, server_version);
+
+	SPI_connect();
+
+	for (;;)
+	{
+		pgds_read_bytes(&sf, &tag, 1);
+
+		if (tag == 'E')
+			break;
+		else if (tag == 'R')
+		{
+			char	*nspname = pgds_read_string(&sf);
+			char	*relname = pgds_read_string(&sf);
+			int32	relpages;
+			float4	reltuples;
+			int32	relallvisible;
+			Oid	nspid;
+			char	relkind;
+
+			pgds_read_net32(&sf, &relpages);
+			pgds_read_net32(&sf, &reltuples);
+			pgds_read_net32(&sf, &relallvisible);
+
+			relid = InvalidOid;
+			nspid = get_namespace_oid(nspname, true);
+			if (OidIsValid(nspid))
+				relid = get_relname_relid(relname, nspid);
+			if (!OidIsValid(relid))
+			{
+				elog(NOTICE, "pgds: skipping statistics of relation \"%s.%s\": relation not found", nspname, relname);
+				continue;
+			}
+			relkind = get_rel_relkind(relid);
+			if (relkind != RELKIND_RELATION && relkind != RELKIND_MATVIEW &&
+			    relkind != RELKIND_PARTITIONED_TABLE && relkind != RELKIND_FOREIGN_TABLE)
+			{
+				elog(NOTICE, "pgds: skipping statistics of relation \"%s.%s\": not a table, materialized view or foreign table",
+				     nspname, relname);
+				relid = InvalidOid;
+				continue;
+			}
+
+			/* take the same lock as ANALYZE */
+			LockRelationOid(relid, ShareUpdateExclusiveLock);
+
+			{
+				Relation	pg_class_rel = table_open(RelationRelationId, RowExclusiveLock);
+				HeapTuple	ctup = SearchSysCacheCopy1(RELOID, ObjectIdGetDatum(relid));
+				Form_pg_class	classform;
+
+				if (!HeapTupleIsValid(ctup))
+					elog(ERROR, "pgds: cache lookup failed for relation %u", relid);
+				classform = (Form_pg_class) GETSTRUCT(ctup);
+				classform->relpages = relpages;
+				classform->reltuples = reltuples;
+				classform->relallvisible = relallvisible;
+				CatalogTupleUpdate(pg_class_rel, &ctup->t_self, ctup);
+				heap_freetuple(ctup);
+				table_close(pg_class_rel, RowExclusiveLock);
+			}
+		}
+		else if (tag == 'A')
+		{
+			if (pgds_import_attr_stats(&sf, relid))
+				nrows++;
+		}
+		else if (tag == 'X')
+		{
+			if (pgds_import_ext_stats(&sf, relid, server_version))
+				nrows++;
+		}
+		else
+			elog(ERROR, "pgds: invalid record type %d in file \"%s\"", tag, filename);
+	}
+
+	SPI_finish();
+	FreeFile(sf.file);
+
+	/* make new statistics visible to following commands of this transaction */
+	CommandCounterIncrement();
+
+	PG_RETURN_INT64(nrows);
+}
+
+
+/*
+ * pgds_stat_sum
+ *
+ * aggregate per backend counters
+ */
+static void pgds_stat_sum(uint64 *sums)
+{
+	int i;
+	int j;
+
+	memset(sums, 0, sizeof(uint64) * PGDS_STAT_COUNT);
+	for (i = 0; i < pgds_nslots; i++)
+		for (j = 0; j < PGDS_STAT_COUNT; j++)
+			sums[j] += pg_atomic_read_u64(&pgds_backend_stats[i].counters[j]);
+}
+
+/*
+ * pgds_histogram_sum
+ *
+ * aggregate per backend histograms
+ */
+static void pgds_histogram_sum(uint64 sums[PGDS_PHASE_COUNT][PGDS_HIST_BUCKETS])
+{
+	int i;
+	int p;
+	int b;
+
+	memset(sums, 0, sizeof(uint64) * PGDS_PHASE_COUNT * PGDS_HIST_BUCKETS);
+	for (i = 0; i < pgds_nslots; i++)
+		for (p = 0; p < PGDS_PHASE_COUNT; p++)
+			for (b = 0; b < PGDS_HIST_BUCKETS; b++)
+				sums[p][b] += pg_atomic_read_u64(&pgds_backend_stats[i].histograms[p][b]);
+}
+
+/*
+ * pgds_latency_histogram
+ *
+ * returns non empty latency histogram buckets of each pgds phase since last reset:
+ * bucket_upper_us is NULL for the last (unbounded) bucket
+ */
+Datum pgds_latency_histogram(PG_FUNCTION_ARGS)
+{
+	Tuplestorestate	*tupstore;
+	TupleDesc	tupdesc;
+	uint64		sums[PGDS_PHASE_COUNT][PGDS_HIST_BUCKETS];
+	Datum		values[4];
+	bool		nulls[4];
+	int		p;
+	int		b;
+
+	if (pgds == NULL)
+		elog(ERROR, "pgds: pgds must be loaded via shared_preload_libraries");
+
+	tupstore = pgds_init_srf(fcinfo, &tupdesc);
+
+	pgds_histogram_sum(sums);
+
+	LWLockAcquire(pgds->lock, LW_SHARED);
+	for (p = 0; p < PGDS_PHASE_COUNT; p++)
+	{
+		for (b = 0; b < PGDS_HIST_BUCKETS; b++)
+		{
+			uint64 base = pgds->histograms_reset_base[p][b];
+
+			if (sums[p][b] <= base)
+				continue;
+
+			memset(nulls, false, sizeof(nulls));
+			values[0] = CStringGetTextDatum(pgds_phase_names[p]);
+			values[1] = Int64GetDatum(b == 0 ? 0 : ((int64) 1) << (b - 1));
+			if (b == PGDS_HIST_BUCKETS - 1)
+				nulls[2] = true;
+			else
+				values[2] = Int64GetDatum(((int64) 1) << b);
+			values[3] = Int64GetDatum((int64) (sums[p][b] - base));
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		}
+	}
+	LWLockRelease(pgds->lock);
+
+	return (Datum) 0;
+}
+
+/*
+ * pgds_bench_query
+ *
+ * build synthetic query tree for pgds_walker_bench: each level has breadth
+ * relations, an IN list of in_list constants and, if depth > 0, the same
+ * child query referenced both as FROM subquery and EXISTS sublink
+ */
+static Query *pgds_bench_query(int breadth, int depth, ArrayExpr *in_list, Oid *next_relid)
+{
+	Query *query = makeNode(Query);
+	ScalarArrayOpExpr *saop = makeNode(ScalarArrayOpExpr);
+	List *quals = NIL;
+	int i;
+
+	query->commandType = CMD_SELECT;
+	for (i = 0; i < breadth; i++)
+	{
+		RangeTblEntry *rte = makeNode(RangeTblEntry);
+
+		rte->rtekind = RTE_RELATION;
+		rte->relid = (*next_relid)++;
+		rte->relkind = RELKIND_RELATION;
+		query->rtable = lappend(query->rtable, rte);
+	}
+
+	saop->opno = Int4EqualOperator;
+	saop->useOr = true;
+	saop->args = list_make2(makeVar(1, 1, INT4OID, -1, InvalidOid, 0), in_list);
+	quals = lappend(quals, saop);
+
+	if (depth > 0)
+	{
+		Query *child = pgds_bench_query(breadth, depth - 1, in_list, next_relid);
+		RangeTblEntry *rte = makeNode(RangeTblEntry);
+		SubLink *sub = makeNode(SubLink);
+
+		rte->rtekind = RTE_SUBQUERY;
+		rte->subquery = child;
+		query->rtable = lappend(query->rtable, rte);
+
+		sub->subLinkType = EXISTS_SUBLINK;
+		sub->subselect = (Node *) child;
+		quals = lappend(quals, sub);
+		query->hasSubLinks = true;
+	}
+
+	query->jointree = makeFromExpr(NIL, (Node *) makeBoolExpr(AND_EXPR, quals, -1));
+
+	return query;
+}
+
+/*
+ * pgds_walker_bench
+ *
+ * run relation walker iterations times over a synthetic query tree
+ */
+Datum pgds_walker_bench(PG_FUNCTION_ARGS)
+{
+	int		breadth = PG_GETARG_INT32(0);
+	int		depth = PG_GETARG_INT32(1);
+	int		nconsts = PG_GETARG_INT32(2);
+	int		iterations = PG_GETARG_INT32(3);
+	ArrayExpr	*in_list = makeNode(ArrayExpr);
+	Oid		next_relid = FirstNormalObjectId;
+	Query		*query;
+	TupleDesc	tupdesc;
+	Datum		values[4];
+	bool		nulls[4] = {false, false, false, false};
+	instr_time	start;
+	instr_time	duration;
+	int		nqueries = 0;
+	int		nrels = 0;
+	int		i;
+
+	if (breadth < 0 || depth < 0 || nconsts < 1 || iterations < 1)
+		elog(ERROR, "pgds: invalid pgds_walker_bench arguments");
+	if ((int64) breadth * (depth + 1) > MAX_REL)
+		elog(ERROR, "pgds: pgds_walker_bench: too many relations (%d)", MAX_REL);
+	if (pgds_rel_index != 0)
+		elog(ERROR, "pgds: pgds_walker_bench: relation walker is busy");
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	in_list->array_typeid = INT4ARRAYOID;
+	in_list->element_typeid = INT4OID;
+	in_list->multidims = false;
+	in_list->location = -1;
+	for (i = 0; i < nconsts; i++)
+		in_list->elements = lappend(in_list->elements,
+					    makeConst(INT4OID, -1, InvalidOid, sizeof(int32),
+						      Int32GetDatum(i), false, true));
+
+	query = pgds_bench_query(breadth, depth, in_list, &next_relid);
+
+	INSTR_TIME_SET_CURRENT(start);
+	for (i = 0; i < iterations; i++)
+	{
+		pgds_rel_index = 0;
+		nqueries = pgds_walk_query(query, NULL);
+		nrels = pgds_rel_index;
+	}
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	pgds_rel_index = 0;
+
+	values[0] = Int32GetDatum(nqueries);
+	values[1] = Int32GetDatum(nrels);
+	values[2] = Int64GetDatum((int64) INSTR_TIME_GET_MICROSEC(duration));
+	values[3] = Float8GetDatum(INSTR_TIME_GET_DOUBLE(duration) * 1e9 / iterations);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+/*
+ * pgds_standby_demand
+ *
+ * returns standby demand ring: entries are removed if consume is true
+ */
+Datum pgds_standby_demand(PG_FUNCTION_ARGS)
+{
+	bool		consume = PG_GETARG_BOOL(0);
+	Tuplestorestate	*tupstore;
+	TupleDesc	tupdesc;
+	Datum		values[5];
+	bool		nulls[5];
+	int		i;
+
+	if (pgds == NULL)
+		elog(ERROR, "pgds: pgds must be loaded via shared_preload_libraries");
+
+	tupstore = pgds_init_srf(fcinfo, &tupdesc);
+
+	memset(nulls, false, sizeof(nulls));
+	LWLockAcquire(pgds->lock, consume ? LW_EXCLUSIVE : LW_SHARED);
+	for (i = 0; i < PGDS_DEMAND_RING; i++)
+	{
+		pgdsDemand *d = &pgds->demand[i];
+
+		if (!OidIsValid(d->relid))
+			continue;
+		values[0] = ObjectIdGetDatum(d->dboid);
+		values[1] = ObjectIdGetDatum(d->relid);
+		values[2] = ObjectIdGetDatum(d->relowner);
+		values[3] = Int64GetDatum(d->demands);
+		values[4] = TimestampTzGetDatum(d->last_demand);
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		if (consume)
+			memset(d, 0, sizeof(pgdsDemand));
+	}
+	LWLockRelease(pgds->lock);
+
+	return (Datum) 0;
+}
+
+/*
+ * pgds_standby_demand_ack
+ *
+ * removes demand of relid in dboid from standby demand ring if it has not
+ * been demanded again since last_demand
+ */
+Datum pgds_standby_demand_ack(PG_FUNCTION_ARGS)
+{
+	Oid		dboid = PG_GETARG_OID(0);
+	Oid		relid = PG_GETARG_OID(1);
+	TimestampTz	last_demand = PG_GETARG_TIMESTAMPTZ(2);
+	bool		removed = false;
+	int		i;
+
+	if (pgds == NULL)
+		elog(ERROR, "pgds: pgds must be loaded via shared_preload_libraries");
+
+	LWLockAcquire(pgds->lock, LW_EXCLUSIVE);
+	for (i = 0; i < PGDS_DEMAND_RING; i++)
+	{
+		pgdsDemand *d = &pgds->demand[i];
+
+		if (d->dboid == dboid && d->relid == relid && OidIsValid(relid))
+		{
+			if (d->last_demand <= last_demand)
+			{
+				memset(d, 0, sizeof(pgdsDemand));
+				removed = true;
+			}
+			break;
+		}
+	}
+	LWLockRelease(pgds->lock);
+
+	PG_RETURN_BOOL(removed);
+}
+
+/*
+ * pgds_function_rows
+ *
+ * returns observed rows of set returning functions
+ */
+Datum pgds_function_rows(PG_FUNCTION_ARGS)
+{
+	Tuplestorestate	*tupstore;
+	TupleDesc	tupdesc;
+	Datum		values[6];
+	bool		nulls[6];
+	HASH_SEQ_STATUS	hash_seq;
+	pgdsFuncRowsEntry *entry;
+
+	if (pgds == NULL)
+		elog(ERROR, "pgds: pgds must be loaded via shared_preload_libraries");
+
+	tupstore = pgds_init_srf(fcinfo, &tupdesc);
+
+	memset(nulls, false, sizeof(nulls));
+	LWLockAcquire(pgds->funcrows_lock, LW_SHARED);
+	hash_seq_init(&hash_seq, pgds_funcrows_hash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		values[0] = ObjectIdGetDatum(entry->key.dboid);
+		values[1] = ObjectIdGetDatum(entry->key.funcid);
+		values[2] = Int64GetDatum((int64) entry->key.argshash);
+		SpinLockAcquire(&entry->mutex);
+		values[3] = Float8GetDatum(entry->rows);
+		values[4] = Int64GetDatum(entry->calls);
+		values[5] = TimestampTzGetDatum(entry->last_call);
+		SpinLockRelease(&entry->mutex);
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+	LWLockRelease(pgds->funcrows_lock);
+
+	return (Datum) 0;
+}
+
+/*
+ * pgds_function_rows_reset
+ */
+Datum pgds_function_rows_reset(PG_FUNCTION_ARGS)
+{
+	HASH_SEQ_STATUS	hash_seq;
+	pgdsFuncRowsEntry *entry;
+
+	if (pgds == NULL)
+		elog(ERROR, "pgds: pgds must be loaded via shared_preload_libraries");
+
+	LWLockAcquire(pgds->funcrows_lock, LW_EXCLUSIVE);
+	hash_seq_init(&hash_seq, pgds_funcrows_hash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+		(void) hash_search(pgds_funcrows_hash, &entry->key, HASH_REMOVE, NULL);
+	LWLockRelease(pgds->funcrows_lock);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * pgds_foreign_rows
+ *
+ * returns observed rows of foreign table scans
+ */
+Datum pgds_foreign_rows(PG_FUNCTION_ARGS)
+{
+	Tuplestorestate	*tupstore;
+	TupleDesc	tupdesc;
+	Datum		values[6];
+	bool		nulls[6];
+	HASH_SEQ_STATUS	hash_seq;
+	pgdsForeignRowsEntry *entry;
+
+	if (pgds == NULL)
+		elog(ERROR, "pgds: pgds must be loaded via shared_preload_libraries");
+
+	tupstore = pgds_init_srf(fcinfo, &tupdesc);
+
+	memset(nulls, false, sizeof(nulls));
+	LWLockAcquire(pgds->foreignrows_lock, LW_SHARED);
+	hash_seq_init(&hash_seq, pgds_foreignrows_hash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		values[0] = ObjectIdGetDatum(entry->key.dboid);
+		values[1] = ObjectIdGetDatum(entry->key.relid);
+		values[2] = Int64GetDatum((int64) entry->key.qualhash);
+		SpinLockAcquire(&entry->mutex);
+		values[3] = Float8GetDatum(entry->rows);
+		values[4] = Int64GetDatum(entry->scans);
+		values[5] = TimestampTzGetDatum(entry->last_scan);
+		SpinLockRelease(&entry->mutex);
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+	LWLockRelease(pgds->foreignrows_lock);
+
+	return (Datum) 0;
+}
+
+/*
+ * pgds_foreign_rows_reset
+ */
+Datum pgds_foreign_rows_reset(PG_FUNCTION_ARGS)
+{
+	HASH_SEQ_STATUS	hash_seq;
+	pgdsForeignRowsEntry *entry;
+
+	if (pgds == NULL)
+		elog(ERROR, "pgds: pgds must be loaded via shared_preload_libraries");
+
+	LWLockAcquire(pgds->foreignrows_lock, LW_EXCLUSIVE);
+	hash_seq_init(&hash_seq, pgds_foreignrows_hash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+		(void) hash_search(pgds_foreignrows_hash, &entry->key, HASH_REMOVE, NULL);
+	LWLockRelease(pgds->foreignrows_lock);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * pgds_provisional_stats
+ *
+ * returns relations having quick statistics not yet replaced by ANALYZE
+ */
+Datum pgds_provisional_stats(PG_FUNCTION_ARGS)
+{
+	Tuplestorestate	*tupstore;
+	TupleDesc	tupdesc;
+	Datum		values[4];
+	bool		nulls[4];
+	int		i;
+
+	if (pgds == NULL)
+		elog(ERROR, "pgds: pgds must be loaded via shared_preload_libraries");
+
+	tupstore = pgds_init_srf(fcinfo, &tupdesc);
+
+	memset(nulls, false, sizeof(nulls));
+	LWLockAcquire(pgds->lock, LW_SHARED);
+	for (i = 0; i < PGDS_PROVISIONAL; i++)
+	{
+		pgdsProvisional *p = &pgds->provisional[i];
+
+		if (p->relid == InvalidOid)
+			continue;
+		values[0] = ObjectIdGetDatum(p->dboid);
+		values[1] = ObjectIdGetDatum(p->relid);
+		values[2] = Int32GetDatum(p->ncolumns);
+		values[3] = TimestampTzGetDatum(p->created);
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+	LWLockRelease(pgds->lock);
+
+	return (Datum) 0;
+}
+
+/*
+ * pgds_governor
+ *
+ * returns sampled pages token bucket and number of running analyses
+ */
+Datum pgds_governor(PG_FUNCTION_ARGS)
+{
+	Tuplestorestate	*tupstore;
+	TupleDesc	tupdesc;
+	Datum		values[3];
+	bool		nulls[3];
+
+	if (pgds == NULL)
+		elog(ERROR, "pgds: pgds must be loaded via shared_preload_libraries");
+
+	tupstore = pgds_init_srf(fcinfo, &tupdesc);
+
+	memset(nulls, false, sizeof(nulls));
+	SpinLockAcquire(&pgds->governor_mutex);
+	values[0] = Float8GetDatum(pgds->io_tokens);
+	values[1] = Int32GetDatum(pgds->running);
+	values[2] = TimestampTzGetDatum(pgds->io_refill);
+	nulls[2] = (pgds->io_refill == 0);
+	SpinLockRelease(&pgds->governor_mutex);
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+	return (Datum) 0;
+}
+
+/*
+ * pgds_events
+ *
+ * returns events of the shared ring, oldest first: entries being
+ * written or overwritten while copied are skipped
+ */
+Datum pgds_events(PG_FUNCTION_ARGS)
+{
+	Tuplestorestate	*tupstore;
+	TupleDesc	tupdesc;
+	Datum		values[7];
+	bool		nulls[7];
+	uint64		end;
+	uint64		pos;
+
+	if (pgds == NULL)
+		elog(ERROR, "pgds: pgds must be loaded via shared_preload_libraries");
+
+	tupstore = pgds_init_srf(fcinfo, &tupdesc);
+
+	end = pg_atomic_read_u64(&pgds->event_pos);
+	pos = (end > PGDS_EVENT_RING) ? end - PGDS_EVENT_RING : 0;
+	for (; pos < end; pos++)
+	{
+		pgdsEvent	*ev = &pgds->events[pos % PGDS_EVENT_RING];
+		pgdsEvent	copy;
+
+		if (pg_atomic_read_u64(&ev->seq) != pos + 1)
+			continue;
+		pg_read_barrier();
+		copy.ts = ev->ts;
+		copy.pid = ev->pid;
+		copy.action = ev->action;
+		copy.dboid = ev->dboid;
+		copy.relid = ev->relid;
+		copy.queryid = ev->queryid;
+		copy.duration_us = ev->duration_us;
+		pg_read_barrier();
+		if (pg_atomic_read_u64(&ev->seq) != pos + 1)
+			continue;
+
+		memset(nulls, false, sizeof(nulls));
+		values[0] = TimestampTzGetDatum(copy.ts);
+		values[1] = Int32GetDatum(copy.pid);
+		values[2] = ObjectIdGetDatum(copy.dboid);
+		if (OidIsValid(copy.relid))
+			values[3] = ObjectIdGetDatum(copy.relid);
+		else
+			nulls[3] = true;
+		values[4] = Int64GetDatum((int64) copy.queryid);
+		values[5] = CStringGetTextDatum(pgds_event_names[copy.action]);
+		values[6] = Int64GetDatum(copy.duration_us);
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * pgds_stat
+ *
+ * returns pg_stat_pgds counters since last reset
+ */
+Datum pgds_stat(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[PGDS_STAT_COUNT + 1];
+	bool		nulls[PGDS_STAT_COUNT + 1];
+	uint64		sums[PGDS_STAT_COUNT];
+	uint64		counter;
+	int		i;
+
+	if (pgds == NULL)
+		elog(ERROR, "pgds: pgds must be loaded via shared_preload_libraries");
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "pgds: return type must be a row type");
+
+	memset(nulls, false, sizeof(nulls));
+	pgds_stat_sum(sums);
+
+	LWLockAcquire(pgds->lock, LW_SHARED);
+	for (i = 0; i < PGDS_STAT_COUNT; i++)
+	{
+		counter = (sums[i] > pgds->stats_reset_base[i]) ? sums[i] - pgds->stats_reset_base[i] : 0;
+		if (i == PGDS_STAT_TIME_US)
+			values[i] = Float8GetDatum((double) counter / 1000.0);
+		else
+			values[i] = Int64GetDatum((int64) counter);
+	}
+	values[PGDS_STAT_COUNT] = TimestampTzGetDatum(pgds->stats_reset);
+	LWLockRelease(pgds->lock);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+/*
+ * pgds_stat_reset
+ */
+Datum pgds_stat_reset(PG_FUNCTION_ARGS)
+{
+	uint64		sums[PGDS_STAT_COUNT];
+
+	if (pgds == NULL)
+		elog(ERROR, "pgds: pgds must be loaded via shared_preload_libraries");
+
+	LWLockAcquire(pgds->lock, LW_EXCLUSIVE);
+	pgds_stat_sum(sums);
+	memcpy(pgds->stats_reset_base, sums, sizeof(sums));
+	pgds_histogram_sum(pgds->histograms_reset_base);
+	pgds->stats_reset = GetCurrentTimestamp();
+	LWLockRelease(pgds->lock);
+
+	PG_RETURN_VOID();
+}
+
+
+/*
+ * pgds_rows_sampled
+ *
+ * estimate number of rows sampled by last ANALYZE of relid
+ */
+static int64 pgds_rows_sampled(Oid relid)
+{
+	HeapTuple	tp;
+	float4		reltuples = 0;
+
+	tp = SearchSysCache1(RELOID, ObjectIdGetDatum(relid));
+	if (HeapTupleIsValid(tp))
+	{
+		reltuples = ((Form_pg_class) GETSTRUCT(tp))->reltuples;
+		ReleaseSysCache(tp);
+	}
+	if (reltuples < 0)
+		reltuples = 0;
+
+	return (int64) Min(reltuples, 300.0 * default_statistics_target);
+}
+
+/*
+ * pgds_relstat_accum
+ */
+static void pgds_relstat_accum(pgdsRelStatCounters *to, pgdsRelStatCounters *from)
+{
+	to->checks += from->checks;
+	to->missing += from->missing;
+	to->stale += from->stale;
+	to->analyses += from->analyses;
+	to->total_analyze_time += from->total_analyze_time;
+	to->max_analyze_time = Max(to->max_analyze_time, from->max_analyze_time);
+	to->rows_sampled += from->rows_sampled;
+	if (from->last_queryid != 0)
+		to->last_queryid = from->last_queryid;
+}
+
+#if PG_VERSION_NUM >= 180000
+
+/*
+ * pgds_relstat_flush_cb
+ *
+ * merge pending counters of this backend into shared statistics entry
+ */
+static bool pgds_relstat_flush_cb(PgStat_EntryRef *entry_ref, bool nowait)
+{
+	pgdsRelStatCounters *pending = (pgdsRelStatCounters *) entry_ref->pending;
+	PgStatShared_PgdsRel *shared = (PgStatShared_PgdsRel *) entry_ref->shared_stats;
+
+	if (!pgstat_lock_entry(entry_ref, nowait))
+		return false;
+	pgds_relstat_accum(&shared->stats, pending);
+	pgstat_unlock_entry(entry_ref);
+
+	return true;
+}
+
+#else
+
+/*
+ * pgds_relstat_load
+ *
+ * reload relation counters dumped at last shutdown: the file is removed so that
+ * counters are not reloaded after a crash
+ */
+static void pgds_relstat_load(void)
+{
+	FILE		*file;
+	uint32		header;
+	uint32		version;
+	int32		num;
+	int32		i;
+	pgdsRelStatEntry dumped;
+
+	file = AllocateFile(PGDS_DUMP_FILE, PG_BINARY_R);
+	if (file == NULL)
+	{
+		if (errno != ENOENT)
+			elog(LOG, "pgds: could not read file \"%s\": %m", PGDS_DUMP_FILE);
+		return;
+	}
+
+	if (fread(&header, sizeof(uint32), 1, file) != 1 ||
+	    fread(&version, sizeof(uint32), 1, file) != 1 ||
+	    fread(&num, sizeof(int32), 1, file) != 1 ||
+	    header != PGDS_DUMP_HEADER || version != PGDS_DUMP_VERSION)
+	{
+		elog(LOG, "pgds: ignoring invalid file \"%s\"", PGDS_DUMP_FILE);
+		FreeFile(file);
+		unlink(PGDS_DUMP_FILE);
+		return;
+	}
+
+	for (i = 0; i < num; i++)
+	{
+		pgdsRelStatEntry *entry;
+		bool	found;
+
+		if (fread(&dumped, sizeof(pgdsRelStatEntry), 1, file) != 1)
+		{
+			elog(LOG, "pgds: could not read file \"%s\": unexpected end of file", PGDS_DUMP_FILE);
+			break;
+		}
+		entry = (pgdsRelStatEntry *) hash_search(pgds_relstat_hash, &dumped.key, HASH_ENTER_NULL, &found);
+		if (entry == NULL)
+			break;
+		SpinLockInit(&entry->mutex);
+		entry->counters = dumped.counters;
+	}
+
+	FreeFile(file);
+	unlink(PGDS_DUMP_FILE);
+}
+
+/*
+ * pgds_relstat_dump
+ *
+ * write relation counters to PGDS_DUMP_FILE: called at postmaster shutdown
+ */
+static void pgds_relstat_dump(void)
+{
+	FILE		*file;
+	uint32		header = PGDS_DUMP_HEADER;
+	uint32		version = PGDS_DUMP_VERSION;
+	int32		num;
+	HASH_SEQ_STATUS	hash_seq;
+	pgdsRelStatEntry *entry;
+
+	if (pgds_relstat_hash == NULL)
+		return;
+
+	file = AllocateFile(PGDS_DUMP_FILE ".tmp", PG_BINARY_W);
+	if (file == NULL)
+		goto error;
+
+	num = hash_get_num_entries(pgds_relstat_hash);
+	if (fwrite(&header, sizeof(uint32), 1, file) != 1 ||
+	    fwrite(&version, sizeof(uint32), 1, file) != 1 ||
+	    fwrite(&num, sizeof(int32), 1, file) != 1)
+		goto error;
+
+	hash_seq_init(&hash_seq, pgds_relstat_hash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		if (fwrite(entry, sizeof(pgdsRelStatEntry), 1, file) != 1)
+		{
+			hash_seq_term(&hash_seq);
+			goto error;
+		}
+	}
+
+	if (FreeFile(file))
+	{
+		file = NULL;
+		goto error;
+	}
+
+	(void) durable_rename(PGDS_DUMP_FILE ".tmp", PGDS_DUMP_FILE, LOG);
+	return;
+
+error:
+	elog(LOG, "pgds: could not write file \"%s\": %m", PGDS_DUMP_FILE ".tmp");
+	if (file)
+		FreeFile(file);
+	unlink(PGDS_DUMP_FILE ".tmp");
+}
+
+#endif
+
+/*
+ * pgds_relstat_report
+ *
+ * add to counters of relid in current database
+ */
+static void pgds_relstat_report(Oid relid, int64 checks, int64 missing, int64 stale,
+				int64 analyses, double analyze_time, int64 rows_sampled)
+{
+	pgdsRelStatCounters delta;
+#if PG_VERSION_NUM >= 180000
+	PgStat_EntryRef *entry_ref;
+#else
+	pgdsRelStatKey	key;
+	pgdsRelStatEntry *entry;
+	bool		found;
+#endif
+
+	if (pgds == NULL)
+		return;
+
+	memset(&delta, 0, sizeof(delta));
+	delta.checks = checks;
+	delta.missing = missing;
+	delta.stale = stale;
+	delta.analyses = analyses;
+	delta.total_analyze_time = analyze_time;
+	delta.max_analyze_time = analyze_time;
+	delta.rows_sampled = rows_sampled;
+	if (analyses > 0)
+		delta.last_queryid = pgds_current_queryid;
+
+#if PG_VERSION_NUM >= 180000
+	entry_ref = pgstat_prep_pending_entry(PGSTAT_KIND_PGDS, MyDatabaseId, (uint64) relid, NULL);
+	pgds_relstat_accum((pgdsRelStatCounters *) entry_ref->pending, &delta);
+#else
+	key.dboid = MyDatabaseId;
+	key.relid = relid;
+
+	LWLockAcquire(pgds->relstat_lock, LW_SHARED);
+	entry = (pgdsRelStatEntry *) hash_search(pgds_relstat_hash, &key, HASH_FIND, NULL);
+	if (entry == NULL)
+	{
+		/* new entry needs exclusive lock: pgds.max_relations entries at most */
+		LWLockRelease(pgds->relstat_lock);
+		LWLockAcquire(pgds->relstat_lock, LW_EXCLUSIVE);
+		entry = (pgdsRelStatEntry *) hash_search(pgds_relstat_hash, &key, HASH_ENTER_NULL, &found);
+		if (entry != NULL && !found)
+		{
+			SpinLockInit(&entry->mutex);
+			memset(&entry->counters, 0, sizeof(pgdsRelStatCounters));
+		}
+	}
+	if (entry != NULL)
+	{
+		SpinLockAcquire(&entry->mutex);
+		pgds_relstat_accum(&entry->counters, &delta);
+		SpinLockRelease(&entry->mutex);
+	}
+	LWLockRelease(pgds->relstat_lock);
+#endif
+}
+
+/*
+ * pgds_relation_stats
+ *
+ * returns per relation counters of all databases (current database only
+ * on PostgreSQL 18, where relations are looked up in pg_class)
+ */
+Datum pgds_relation_stats(PG_FUNCTION_ARGS)
+{
+	Tuplestorestate	*tupstore;
+	TupleDesc	tupdesc;
+	Datum		values[10];
+	bool		nulls[10];
+	pgdsRelStatCounters counters;
+	Oid		dboid;
+	Oid		relid;
+#if PG_VERSION_NUM >= 180000
+	Relation	rel;
+	SysScanDesc	scan;
+	HeapTuple	tup;
+#else
+	HASH_SEQ_STATUS	hash_seq;
+	pgdsRelStatEntry *entry;
+#endif
+
+	if (pgds == NULL)
+		elog(ERROR, "pgds: pgds must be loaded via shared_preload_libraries");
+
+	tupstore = pgds_init_srf(fcinfo, &tupdesc);
+	memset(nulls, false, sizeof(nulls));
+
+#if PG_VERSION_NUM >= 180000
+	/*
+	 * no flush here: pgstat_report_stat() must not run inside a transaction,
+	 * counters of this backend not flushed yet are added from its pending
+	 * entries
+	 */
+	dboid = MyDatabaseId;
+	rel = table_open(RelationRelationId, AccessShareLock);
+	scan = systable_beginscan(rel, InvalidOid, false, NULL, 0, NULL);
+	while ((tup = systable_getnext(scan)) != NULL)
+	{
+		pgdsRelStatCounters *shared;
+		PgStat_EntryRef *entry_ref;
+
+		relid = ((Form_pg_class) GETSTRUCT(tup))->oid;
+		shared = (pgdsRelStatCounters *) pgstat_fetch_entry(PGSTAT_KIND_PGDS, dboid, (uint64) relid);
+		entry_ref = pgstat_fetch_pending_entry(PGSTAT_KIND_PGDS, dboid, (uint64) relid);
+		if (shared == NULL && entry_ref == NULL)
+			continue;
+		memset(&counters, 0, sizeof(counters));
+		if (shared != NULL)
+			pgds_relstat_accum(&counters, shared);
+		if (entry_ref != NULL)
+			pgds_relstat_accum(&counters, (pgdsRelStatCounters *) entry_ref->pending);
+#else
+	LWLockAcquire(pgds->relstat_lock, LW_SHARED);
+	hash_seq_init(&hash_seq, pgds_relstat_hash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		SpinLockAcquire(&entry->mutex);
+		counters = entry->counters;
+		SpinLockRelease(&entry->mutex);
+		dboid = entry->key.dboid;
+		relid = entry->key.relid;
+#endif
+		values[0] = ObjectIdGetDatum(dboid);
+		values[1] = ObjectIdGetDatum(relid);
+		values[2] = Int64GetDatum(counters.checks);
+		values[3] = Int64GetDatum(counters.missing);
+		values[4] = Int64GetDatum(counters.stale);
+		values[5] = Int64GetDatum(counters.analyses);
+		values[6] = Float8GetDatum(counters.total_analyze_time);
+		values[7] = Float8GetDatum(counters.max_analyze_time);
+		values[8] = Int64GetDatum(counters.rows_sampled);
+		values[9] = Int64GetDatum((int64) counters.last_queryid);
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+#if PG_VERSION_NUM >= 180000
+	systable_endscan(scan);
+	table_close(rel, AccessShareLock);
+#else
+	LWLockRelease(pgds->relstat_lock);
+#endif
+
+	return (Datum) 0;
+}
+
+/*
+ * pgds_relation_stats_reset
+ */
+Datum pgds_relation_stats_reset(PG_FUNCTION_ARGS)
+{
+#if PG_VERSION_NUM < 180000
+	HASH_SEQ_STATUS	hash_seq;
+	pgdsRelStatEntry *entry;
+#endif
+
+	if (pgds == NULL)
+		elog(ERROR, "pgds: pgds must be loaded via shared_preload_libraries");
+
+#if PG_VERSION_NUM >= 180000
+	pgstat_reset_of_kind(PGSTAT_KIND_PGDS);
+#else
+	LWLockAcquire(pgds->relstat_lock, LW_EXCLUSIVE);
+	hash_seq_init(&hash_seq, pgds_relstat_hash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+		(void) hash_search(pgds_relstat_hash, &entry->key, HASH_REMOVE, NULL);
+	LWLockRelease(pgds->relstat_lock);
+#endif
+
+	PG_RETURN_VOID();
+}
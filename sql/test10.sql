@@ -0,0 +1,11 @@
+--
+-- test10.sql
+--
+create function tenant_items(t int) returns setof int language plpgsql as
+$$ begin return query select generate_series(1, t * 10); end $$;
+create function plan_rows(q text) returns float8 language plpgsql as
+$$ declare p json; begin execute 'explain (format json) ' || q into p; return p->0->'Plan'->>'Plan Rows'; end $$;
+select plan_rows('select * from tenant_items(5)');
+select count(*) from tenant_items(5);
+select rows, calls from pg_stat_pgds_functions where funcid = 'tenant_items(int)'::regprocedure and argshash <> 0;
+select plan_rows('select * from tenant_items(5)');
@@ -0,0 +1,18 @@
+--
+-- test11.sql
+--
+create table trls_allowed as select 1 as k;
+create table trls as select 1 as k;
+alter table trls enable row level security;
+create policy trls_p on trls using (k in (select k from trls_allowed));
+select count(*) from trls;
+create table trule_log as select 1 as k;
+create table trule as select 1 as k;
+create rule trule_r as on insert to trule do also insert into trule_log select new.k;
+insert into trule values (2);
+create table tfunc as select 1 as k;
+create function tfunc_count() returns bigint language sql return (select count(*) from tfunc);
+select tfunc_count();
+create table tfunc2 as select 2 as k;
+create or replace function tfunc_count() returns bigint language sql return (select count(*) from tfunc2);
+select tfunc_count();
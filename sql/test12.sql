@@ -0,0 +1,16 @@
+--
+-- test12.sql
+--
+create table tbatch1 as select generate_series(1, 100) i;
+create table tbatch2 as select generate_series(1, 100) i;
+analyze tbatch1;
+analyze tbatch2;
+select count(*) from tbatch1 join tbatch2 using (i);
+select batched_probes >= 2 as batched from pg_stat_pgds;
+create table tbatch3 as select generate_series(1, 100) i;
+create table tbatch4 as select generate_series(1, 100) i;
+analyze tbatch3;
+analyze tbatch4;
+select batched_probes as before from pg_stat_pgds \gset
+update tbatch3 set i = i where false \; delete from tbatch4 where false;
+select batched_probes - :before as lookahead from pg_stat_pgds;
@@ -0,0 +1,11 @@
+--
+-- test13.sql
+--
+create table texpr as select 'U' || i as email from generate_series(1, 100) i;
+analyze texpr;
+select count(*) from texpr;
+create index texpr_lower on texpr (lower(email));
+select count(*) from texpr where lower(email) = 'u1';
+select count(*) > 0 as expr_stats from pg_statistic where starelid = 'texpr_lower'::regclass;
+create index texpr_part on texpr (upper(email)) where email = 'none';
+select count(*) from texpr where lower(email) = 'u2';
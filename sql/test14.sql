@@ -0,0 +1,10 @@
+--
+-- test14.sql
+--
+set pgds.quick_stats_min_pages = 1;
+create table tquick as select generate_series(1, 1000) i;
+alter table tquick add primary key (i);
+select count(*) from tquick where i < 100;
+select count(*) as quick from pgds_events() where action = 'quick stats' and relid = 'tquick'::regclass;
+select quick_stats > 0 as quick_stats from pg_stat_pgds;
+reset pgds.quick_stats_min_pages;
@@ -0,0 +1,5 @@
+--
+-- test15.sql
+--
+select running, io_refill is null as idle from pgds_governor();
+select governor_deferred from pg_stat_pgds;
@@ -0,0 +1,11 @@
+--
+-- test6.sql
+--
+create table t600 as select i as a, i % 5 as b, i as c from generate_series(1, 10) i;
+create table q600 as select 'select a from t600 where b = $1'::text as query;
+--
+select * from pgds_prewarm_from_statements('q600');
+--
+select staattnum from pg_statistic where starelid = 't600'::regclass order by 1;
+--
+select * from pgds_prewarm_from_statements('q600');
@@ -0,0 +1,20 @@
+--
+-- test7.sql
+--
+create table t700 as select i as a, i % 5 as b from generate_series(1, 10) i;
+analyze t700;
+--
+select pgds_export_stats(array['t700'::regclass], 'pgds_test7.stats');
+--
+delete from pg_statistic where starelid = 't700'::regclass;
+select count(*) from pg_statistic where starelid = 't700'::regclass;
+--
+select pgds_import_stats('pgds_test7.stats');
+select staattnum from pg_statistic where starelid = 't700'::regclass order by 1;
+--
+create table t701 as select 1 as a;
+analyze t701;
+select pgds_export_stats(array['t701'::regclass], 'pgds_test7v.stats');
+drop table t701;
+create view t701 as select 1 as a;
+select pgds_import_stats('pgds_test7v.stats');
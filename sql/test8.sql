@@ -0,0 +1,16 @@
+--
+-- test8.sql
+--
+create table t800 as select i as a from generate_series(1, 10) i;
+select count(*) from t800;
+select calls > 0 as calls, rels_examined > 0 as rels, catalog_probes > 0 as probes from pg_stat_pgds;
+--
+select analyses > 0 as analyses from pg_stat_pgds_relations where relid = 't800'::regclass;
+--
+select count > 0 as count, p99_us >= p50_us as ordered from pg_stat_pgds_latency where phase = 'tree walk';
+--
+select count(*) > 0 as analyzed from pgds_events() where action = 'analyze' and relid = 't800'::regclass;
+--
+select queries, relations from pgds_walker_bench(3, 4, 1000, 10);
+--
+select count(*) as demands from pgds_standby_demand();
@@ -0,0 +1,23 @@
+--
+-- test9.sql
+--
+create table tbrin (i int) with (autovacuum_enabled = off);
+create index tbrin_i on tbrin using brin (i) with (pages_per_range = 1);
+insert into tbrin select generate_series(1, 20000);
+select count(*) from tbrin where i = 1;
+select brin_queued > 0 as brin_queued from pg_stat_pgds;
+--
+create table tvm with (autovacuum_enabled = off) as select generate_series(1, 50000) i;
+create index tvm_i on tvm(i);
+analyze tvm;
+select count(*) from tvm where i < 10;
+select vacuum_queued > 0 as vacuum_queued from pg_stat_pgds;
+--
+create table tgin (a int[]) with (autovacuum_enabled = off);
+create index tgin_a on tgin using gin (a) with (fastupdate = on);
+insert into tgin select array[i % 100, i % 7] from generate_series(1, 1000) i;
+analyze tgin;
+set pgds.gin_pending_pages = 1;
+select count(*) from tgin where a @> '{1}';
+reset pgds.gin_pending_pages;
+select gin_queued > 0 as gin_queued from pg_stat_pgds;
@@ -0,0 +1,127 @@
+#
+# t/001_analyze_storm.pl
+#
+# concurrent clients hit freshly created relations without statistics:
+# reports number of ANALYZE run, lock waits, pgds analyze waits and
+# p50/p99/max latency of first query of each client.
+#
+# settings (environment):
+# PGDS_STRESS_CLIENTS	number of pgbench clients (default 50)
+# PGDS_STRESS_ROWS	rows of each table (default 100000)
+#
+use strict;
+use warnings;
+
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+use IPC::Run;
+
+my $clients = $ENV{PGDS_STRESS_CLIENTS} || 50;
+my $rows = $ENV{PGDS_STRESS_ROWS} || 100000;
+
+my $node = PostgreSQL::Test::Cluster->new('storm');
+$node->init;
+$node->append_conf('postgresql.conf', qq{
+shared_preload_libraries = 'pgds'
+max_connections = @{[ $clients + 20 ]}
+log_lock_waits = on
+deadlock_timeout = 10ms
+});
+$node->start;
+$node->safe_psql('postgres', 'create extension pgds');
+
+my %scenarios = (
+	table => {
+		setup => qq{
+			create table storm_t(id int, x int);
+			insert into storm_t select g, g % 100 from generate_series(1, $rows) g;
+		},
+		query => 'select count(*) from storm_t where x = 1;',
+		tables => [ 'storm_t' ],
+	},
+	view => {
+		setup => qq{
+			create table storm_v1(id int, x int);
+			create table storm_v2(id int, x int);
+			insert into storm_v1 select g, g % 100 from generate_series(1, $rows) g;
+			insert into storm_v2 select g, g % 100 from generate_series(1, $rows) g;
+			create view storm_v as select * from storm_v1 union all select * from storm_v2;
+		},
+		query => 'select count(*) from storm_v where x = 1;',
+		tables => [ 'storm_v1', 'storm_v2' ],
+	},
+	partition => {
+		setup => qq{
+			create table storm_p(id int, x int) partition by range(id);
+			create table storm_p1 partition of storm_p for values from (1) to ($rows / 2 + 1);
+			create table storm_p2 partition of storm_p for values from ($rows / 2 + 1) to ($rows + 1);
+			insert into storm_p select g, g % 100 from generate_series(1, $rows) g;
+		},
+		query => 'select count(*) from storm_p where x = 1;',
+		tables => [ 'storm_p1', 'storm_p2' ],
+	},
+);
+
+foreach my $name (sort keys %scenarios)
+{
+	my $s = $scenarios{$name};
+	my $dir = PostgreSQL::Test::Utils::tempdir();
+	my $script = "$dir/storm.sql";
+	my ($stdout, $stderr);
+
+	$node->safe_psql('postgres', $s->{setup});
+	$node->safe_psql('postgres',
+		'select pgds_stat_reset(); select pgds_relation_stats_reset();');
+	my $log_offset = -s $node->logfile;
+
+	open my $fh, '>', $script or die "could not create $script: $!";
+	print $fh $s->{query} . "\n";
+	close $fh;
+
+	my $success = IPC::Run::run(
+		[ 'pgbench', '-n', '-M', 'simple',
+		'-h', $node->host, '-p', $node->port,
+		'-c', $clients, '-j', $clients > 32 ? 32 : $clients,
+		'-t', 1, '-l', '--log-prefix', "$dir/storm",
+		'-f', $script, 'postgres' ],
+		'>', \$stdout, '2>', \$stderr);
+	ok($success, "$name: pgbench run") or diag($stderr);
+
+	# transaction log: client_id transaction_no latency_us ...
+	my @latencies;
+	foreach my $file (glob("$dir/storm.*"))
+	{
+		open my $lf, '<', $file or die "could not open $file: $!";
+		while (my $line = <$lf>)
+		{
+			my @f = split /\s+/, $line;
+			push @latencies, $f[2] / 1000.0 if $f[1] == 0;
+		}
+		close $lf;
+	}
+	@latencies = sort { $a <=> $b } @latencies;
+	my $p50 = $latencies[ int($#latencies * 0.50) ];
+	my $p99 = $latencies[ int($#latencies * 0.99) ];
+	my $max = $latencies[-1];
+
+	my $in = join(',', map { "'$_'::regclass" } @{ $s->{tables} });
+	my $analyses = $node->safe_psql('postgres',
+		"select coalesce(sum(analyses), 0) from pg_stat_pgds_relations where relid in ($in)");
+	my $waits = $node->safe_psql('postgres',
+		"select count(*) from pgds_events() where action = 'analyze wait' and relid in ($in)");
+	my $log = slurp_file($node->logfile, $log_offset);
+	my $lock_waits = () = $log =~ /still waiting for/g;
+
+	diag(sprintf("%-10s clients=%d analyses=%d pgds waits=%d lock waits=%d "
+		  . "first query p50=%.1f ms p99=%.1f ms max=%.1f ms",
+		$name, $clients, $analyses, $waits, $lock_waits, $p50, $p99, $max));
+
+	cmp_ok($analyses, '>=', scalar @{ $s->{tables} }, "$name: tables analyzed");
+	cmp_ok($analyses, '<', $clients * scalar @{ $s->{tables} },
+		"$name: concurrent analyses deduplicated");
+	is(scalar @latencies, $clients, "$name: first query of each client logged");
+}
+
+$node->stop;
+done_testing();
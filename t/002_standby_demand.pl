@@ -0,0 +1,68 @@
+#
+# t/002_standby_demand.pl
+#
+# a query run on a hot standby finds a table without statistics: pgds
+# records a demand instead of running ANALYZE, the demand worker of the
+# primary pulls it and analyzes the table, statistics are replayed on
+# the standby.
+#
+use strict;
+use warnings;
+
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $primary = PostgreSQL::Test::Cluster->new('primary');
+my $standby = PostgreSQL::Test::Cluster->new('standby');
+
+$primary->init(allows_streaming => 1);
+$primary->append_conf('postgresql.conf', qq{
+shared_preload_libraries = 'pgds'
+autovacuum = off
+pgds.mode = off
+pgds.standby_conninfo = '@{[ $standby->connstr('postgres') ]}'
+pgds.standby_poll_interval = 1s
+});
+$primary->start;
+
+$primary->safe_psql('postgres', q{
+CREATE EXTENSION pgds;
+CREATE TABLE t_demand AS SELECT i, i % 10 AS m FROM generate_series(1, 10000) i;
+});
+
+$primary->backup('backup');
+$standby->init_from_backup($primary, 'backup', has_streaming => 1);
+$standby->append_conf('postgresql.conf', qq{
+pgds.mode = sync
+});
+$standby->start;
+$primary->wait_for_catchup($standby, 'replay');
+
+is($standby->safe_psql('postgres',
+	q{SELECT count(*) FROM pg_statistic WHERE starelid = 't_demand'::regclass}),
+	'0', 'no statistics on standby');
+
+# standby cannot analyze: query must succeed and record a demand
+is($standby->safe_psql('postgres', q{SELECT count(*) FROM t_demand WHERE m = 1}),
+	'1000', 'query on standby');
+is($standby->safe_psql('postgres',
+	q{SELECT standby_demands > 0 AND errors = 0 FROM pg_stat_pgds}),
+	't', 'demand recorded without error');
+
+# primary pulls demand and analyzes table
+ok($primary->poll_query_until('postgres',
+	q{SELECT count(*) > 0 FROM pg_statistic WHERE starelid = 't_demand'::regclass}),
+	'table analyzed on primary');
+
+$primary->wait_for_catchup($standby, 'replay');
+ok($standby->safe_psql('postgres',
+	q{SELECT count(*) FROM pg_statistic WHERE starelid = 't_demand'::regclass}) > 0,
+	'statistics replayed on standby');
+is($standby->safe_psql('postgres', q{SELECT count(*) FROM pgds_standby_demand() WHERE relid = 't_demand'::regclass}),
+	'0', 'demand consumed');
+
+$standby->stop;
+$primary->stop;
+
+done_testing();
@@ -0,0 +1,78 @@
+#
+# t/003_foreign_table.pl
+#
+# a query on a postgres_fdw foreign table without statistics queues its
+# ANALYZE for a pgds worker, which samples pgds.foreign_sample_rows rows
+# of the remote table. Rows returned by the foreign scan then replace the
+# planner estimate of the same scan.
+#
+use strict;
+use warnings;
+
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $remote = PostgreSQL::Test::Cluster->new('remote');
+my $local = PostgreSQL::Test::Cluster->new('local');
+
+$remote->init;
+$remote->start;
+$remote->safe_psql('postgres', q{
+CREATE TABLE t_remote AS SELECT i, i % 10 AS m FROM generate_series(1, 10000) i;
+ANALYZE t_remote;
+});
+
+$local->init;
+$local->append_conf('postgresql.conf', qq{
+shared_preload_libraries = 'pgds'
+autovacuum = off
+pgds.mode = sync
+pgds.foreign_sample_rows = 300
+});
+$local->start;
+
+my $remote_port = $remote->port;
+my $remote_host = $remote->host;
+$local->safe_psql('postgres', qq{
+CREATE EXTENSION pgds;
+CREATE EXTENSION postgres_fdw;
+CREATE SERVER remote FOREIGN DATA WRAPPER postgres_fdw
+  OPTIONS (host '$remote_host', port '$remote_port', dbname 'postgres');
+CREATE USER MAPPING FOR CURRENT_USER SERVER remote;
+CREATE FOREIGN TABLE t_foreign (i int, m int) SERVER remote
+  OPTIONS (table_name 't_remote');
+});
+
+# foreign table is never analyzed by the backend, even in sync mode
+is($local->safe_psql('postgres', q{SELECT count(*) FROM t_foreign WHERE m = 1}),
+	'1000', 'query on foreign table');
+is($local->safe_psql('postgres',
+	q{SELECT analyze_sync, errors FROM pg_stat_pgds}),
+	'0|0', 'no inline analyze');
+
+ok($local->poll_query_until('postgres',
+	q{SELECT count(*) > 0 FROM pg_statistic WHERE starelid = 't_foreign'::regclass}),
+	'foreign table analyzed by worker');
+
+# statistics target 1 for 300 sampled rows: histogram has 2 bounds
+is($local->safe_psql('postgres',
+	q{SELECT array_length(histogram_bounds, 1) FROM pg_stats WHERE tablename = 't_foreign' AND attname = 'i'}),
+	'2', 'sample size');
+
+# observed rows replace estimate of the same scan: correlated clauses
+# are estimated to return a few rows from local statistics
+$local->safe_psql('postgres', q{SELECT * FROM t_foreign WHERE m = 1 AND i % 10 = 1});
+is($local->safe_psql('postgres',
+	q{SELECT rows, scans FROM pg_stat_pgds_foreign_tables WHERE relid = 't_foreign'::regclass AND qualhash <> 0 ORDER BY last_scan DESC LIMIT 1}),
+	'1000|1', 'observed rows');
+like($local->safe_psql('postgres',
+	q{EXPLAIN SELECT * FROM t_foreign WHERE i % 10 = 1 AND m = 1}),
+	qr/rows=1000 /, 'estimate replaced');
+ok($local->safe_psql('postgres', q{SELECT foreign_estimates > 0 FROM pg_stat_pgds}) eq 't',
+	'estimate counted');
+
+$local->stop;
+$remote->stop;
+
+done_testing();
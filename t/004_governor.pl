@@ -0,0 +1,57 @@
+#
+# t/004_governor.pl
+#
+# pgds.io_pages_per_second is low: a first table without statistics is
+# analyzed inline and leaves the sampled pages token bucket in debt, the
+# analysis of a second table is deferred to a pgds worker, which waits
+# for the bucket to refill before analyzing it.
+#
+use strict;
+use warnings;
+
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node = PostgreSQL::Test::Cluster->new('governor');
+$node->init;
+$node->append_conf('postgresql.conf', qq{
+shared_preload_libraries = 'pgds'
+autovacuum = off
+pgds.io_pages_per_second = 1
+pgds.max_concurrent_analyses = 1
+});
+$node->start;
+
+$node->safe_psql('postgres', q{
+CREATE EXTENSION pgds;
+CREATE TABLE t_first AS SELECT i FROM generate_series(1, 2000) i;
+CREATE TABLE t_second AS SELECT i FROM generate_series(1, 2000) i;
+});
+
+# first analysis is admitted and charged about 9 pages
+is($node->safe_psql('postgres', q{SELECT count(*) FROM t_first WHERE i < 10}),
+	'9', 'query on first table');
+ok($node->safe_psql('postgres',
+	q{SELECT count(*) FROM pg_statistic WHERE starelid = 't_first'::regclass}) > 0,
+	'first table analyzed inline');
+ok($node->safe_psql('postgres', q{SELECT io_tokens < 0 FROM pgds_governor()}) eq 't',
+	'token bucket in debt');
+
+# second analysis is deferred: statement does not wait for it
+is($node->safe_psql('postgres', q{SELECT count(*) FROM t_second WHERE i < 10}),
+	'9', 'query on second table');
+is($node->safe_psql('postgres',
+	q{SELECT governor_deferred > 0 AND errors = 0 FROM pg_stat_pgds}),
+	't', 'analysis deferred');
+
+# worker analyzes it once bucket has refilled
+ok($node->poll_query_until('postgres',
+	q{SELECT count(*) > 0 FROM pg_statistic WHERE starelid = 't_second'::regclass}),
+	'second table analyzed by worker');
+is($node->safe_psql('postgres', q{SELECT running FROM pgds_governor()}),
+	'0', 'no running analysis');
+
+$node->stop;
+
+done_testing();